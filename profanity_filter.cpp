@@ -2,105 +2,6938 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 #include <regex>
 #include <algorithm>
 #include <unordered_map>
 #include <memory>
+#include <memory_resource>
 #include <fstream>
 #include <sstream>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <tuple>
+#include <string_view>
+#include <array>
+#include <cstring>
+#include <bitset>
+#include <cctype>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <functional>
+#include <exception>
+#include <future>
+#include <optional>
+#include <chrono>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define PROFANITY_FILTER_HAS_COROUTINES 1
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief 单字节大小写折叠，与 C 语言环境下的 ::tolower 结果一致
+ *
+ * 匹配器逐字节调用，不需要预先构造文本的小写副本。
+ */
+constexpr unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+/**
+ * @brief 单词字符表：字母、数字、'_' 以及 UTF-8 多字节字符的字节属于单词，其余字节是边界
+ */
+inline bool isWordByte(unsigned char c) {
+    static constexpr auto kWordBytes = [] {
+        std::array<bool, 256> table{};
+        for (int b = 0; b < 256; ++b) {
+            table[b] = (b >= '0' && b <= '9') || (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_' ||
+                       b >= 0x80;
+        }
+        return table;
+    }();
+    return kWordBytes[c];
+}
+
+/**
+ * @brief UTF-8 大小写折叠 - 把大写字母映射为小写，且不改变每个字符的字节数
+ *
+ * ASCII 连续段用向量指令（SSE2/AVX2）一次处理 16/32 个字节，非 ASCII 字符查表：
+ * 两字节字符（拉丁扩展、希腊、西里尔等）直接查 U+0080~U+07FF 的映射表，
+ * 三字节字符（越南语拉丁扩展、全角字母等）在区间表中二分查找。
+ * 折叠后的字节数与原文相同，匹配结果的偏移可以直接用于原文。
+ * 折叠后字节数会变化的字符（如 U+0130、U+212A）保持原样；无效的 UTF-8 字节原样复制。
+ */
+class Utf8CaseFolder {
+public:
+    /**
+     * @brief 折叠 in 的前缀写入 out（至少 len 字节），返回处理的字节数
+     * @param last 为 false 时，末尾不完整的多字节字符留到下一次处理（此时 len 应不小于 4）
+     */
+    static size_t fold(const char* in, size_t len, char* out, bool last) {
+        const auto* src = reinterpret_cast<const unsigned char*>(in);
+        auto* dst = reinterpret_cast<unsigned char*>(out);
+        size_t pos = 0;
+        while (pos < len) {
+            pos = foldAscii(src, len, dst, pos);
+            if (pos == len) {
+                break;
+            }
+
+            // 非 ASCII：按 UTF-8 长度处理一个字符
+            unsigned char lead = src[pos];
+            size_t length = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc2 ? 2 : 1;
+            if (pos + length > len) {
+                if (!last) {
+                    return pos;
+                }
+                length = 1;
+            }
+            if (length == 2 && isContinuation(src[pos + 1])) {
+                uint32_t cp = ((lead & 0x1fu) << 6) | (src[pos + 1] & 0x3fu);
+                cp = twoByteTable()[cp - 0x80];
+                dst[pos] = static_cast<unsigned char>(0xc0 | (cp >> 6));
+                dst[pos + 1] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+            } else if (length == 3 && isContinuation(src[pos + 1]) && isContinuation(src[pos + 2])) {
+                uint32_t cp = ((lead & 0x0fu) << 12) | ((src[pos + 1] & 0x3fu) << 6) | (src[pos + 2] & 0x3fu);
+                cp = foldThreeByte(cp);
+                dst[pos] = static_cast<unsigned char>(0xe0 | (cp >> 12));
+                dst[pos + 1] = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3f));
+                dst[pos + 2] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+            } else {
+                if (length != 4 || !isContinuation(src[pos + 1]) || !isContinuation(src[pos + 2]) ||
+                    !isContinuation(src[pos + 3])) {
+                    length = 1;
+                }
+                std::memcpy(dst + pos, src + pos, length);
+            }
+            pos += length;
+        }
+        return len;
+    }
+
+    /**
+     * @brief 折叠整个字符串，用于预处理脏话
+     */
+    static std::string foldString(std::string_view text) {
+        std::string folded(text.size(), '\0');
+        fold(text.data(), text.size(), folded.data(), true);
+        return folded;
+    }
+
+private:
+    struct FoldRange {
+        uint32_t first;
+        uint32_t last;
+        int32_t delta;  // 折叠后的码位 = 码位 + delta
+        uint32_t stride; // 1 表示区间内每个码位都映射，2 表示只映射与 first 奇偶相同的码位
+    };
+
+    // 由 Unicode 大小写折叠数据生成，只保留折叠前后 UTF-8 长度相同的单字符映射
+    static constexpr FoldRange kFoldRanges[] = {
+        {0x00B5, 0x00B5, 775, 1},
+        {0x00C0, 0x00D6, 32, 1},
+        {0x00D8, 0x00DE, 32, 1},
+        {0x0100, 0x012E, 1, 2},
+        {0x0132, 0x0136, 1, 2},
+        {0x0139, 0x0147, 1, 2},
+        {0x014A, 0x0176, 1, 2},
+        {0x0178, 0x0178, -121, 1},
+        {0x0179, 0x017D, 1, 2},
+        {0x0181, 0x0181, 210, 1},
+        {0x0182, 0x0184, 1, 2},
+        {0x0186, 0x0186, 206, 1},
+        {0x0187, 0x0187, 1, 1},
+        {0x0189, 0x018A, 205, 1},
+        {0x018B, 0x018B, 1, 1},
+        {0x018E, 0x018E, 79, 1},
+        {0x018F, 0x018F, 202, 1},
+        {0x0190, 0x0190, 203, 1},
+        {0x0191, 0x0191, 1, 1},
+        {0x0193, 0x0193, 205, 1},
+        {0x0194, 0x0194, 207, 1},
+        {0x0196, 0x0196, 211, 1},
+        {0x0197, 0x0197, 209, 1},
+        {0x0198, 0x0198, 1, 1},
+        {0x019C, 0x019C, 211, 1},
+        {0x019D, 0x019D, 213, 1},
+        {0x019F, 0x019F, 214, 1},
+        {0x01A0, 0x01A4, 1, 2},
+        {0x01A6, 0x01A6, 218, 1},
+        {0x01A7, 0x01A7, 1, 1},
+        {0x01A9, 0x01A9, 218, 1},
+        {0x01AC, 0x01AC, 1, 1},
+        {0x01AE, 0x01AE, 218, 1},
+        {0x01AF, 0x01AF, 1, 1},
+        {0x01B1, 0x01B2, 217, 1},
+        {0x01B3, 0x01B5, 1, 2},
+        {0x01B7, 0x01B7, 219, 1},
+        {0x01B8, 0x01B8, 1, 1},
+        {0x01BC, 0x01BC, 1, 1},
+        {0x01C4, 0x01C4, 2, 1},
+        {0x01C5, 0x01C5, 1, 1},
+        {0x01C7, 0x01C7, 2, 1},
+        {0x01C8, 0x01C8, 1, 1},
+        {0x01CA, 0x01CA, 2, 1},
+        {0x01CB, 0x01DB, 1, 2},
+        {0x01DE, 0x01EE, 1, 2},
+        {0x01F1, 0x01F1, 2, 1},
+        {0x01F2, 0x01F4, 1, 2},
+        {0x01F6, 0x01F6, -97, 1},
+        {0x01F7, 0x01F7, -56, 1},
+        {0x01F8, 0x021E, 1, 2},
+        {0x0220, 0x0220, -130, 1},
+        {0x0222, 0x0232, 1, 2},
+        {0x023B, 0x023B, 1, 1},
+        {0x023D, 0x023D, -163, 1},
+        {0x0241, 0x0241, 1, 1},
+        {0x0243, 0x0243, -195, 1},
+        {0x0244, 0x0244, 69, 1},
+        {0x0245, 0x0245, 71, 1},
+        {0x0246, 0x024E, 1, 2},
+        {0x0345, 0x0345, 116, 1},
+        {0x0370, 0x0372, 1, 2},
+        {0x0376, 0x0376, 1, 1},
+        {0x037F, 0x037F, 116, 1},
+        {0x0386, 0x0386, 38, 1},
+        {0x0388, 0x038A, 37, 1},
+        {0x038C, 0x038C, 64, 1},
+        {0x038E, 0x038F, 63, 1},
+        {0x0391, 0x03A1, 32, 1},
+        {0x03A3, 0x03AB, 32, 1},
+        {0x03C2, 0x03C2, 1, 1},
+        {0x03CF, 0x03CF, 8, 1},
+        {0x03D0, 0x03D0, -30, 1},
+        {0x03D1, 0x03D1, -25, 1},
+        {0x03D5, 0x03D5, -15, 1},
+        {0x03D6, 0x03D6, -22, 1},
+        {0x03D8, 0x03EE, 1, 2},
+        {0x03F0, 0x03F0, -54, 1},
+        {0x03F1, 0x03F1, -48, 1},
+        {0x03F4, 0x03F4, -60, 1},
+        {0x03F5, 0x03F5, -64, 1},
+        {0x03F7, 0x03F7, 1, 1},
+        {0x03F9, 0x03F9, -7, 1},
+        {0x03FA, 0x03FA, 1, 1},
+        {0x03FD, 0x03FF, -130, 1},
+        {0x0400, 0x040F, 80, 1},
+        {0x0410, 0x042F, 32, 1},
+        {0x0460, 0x0480, 1, 2},
+        {0x048A, 0x04BE, 1, 2},
+        {0x04C0, 0x04C0, 15, 1},
+        {0x04C1, 0x04CD, 1, 2},
+        {0x04D0, 0x052E, 1, 2},
+        {0x0531, 0x0556, 48, 1},
+        {0x10A0, 0x10C5, 7264, 1},
+        {0x10C7, 0x10C7, 7264, 1},
+        {0x10CD, 0x10CD, 7264, 1},
+        {0x13F8, 0x13FD, -8, 1},
+        {0x1C88, 0x1C88, 35267, 1},
+        {0x1C90, 0x1CBA, -3008, 1},
+        {0x1CBD, 0x1CBF, -3008, 1},
+        {0x1E00, 0x1E94, 1, 2},
+        {0x1E9B, 0x1E9B, -58, 1},
+        {0x1EA0, 0x1EFE, 1, 2},
+        {0x1F08, 0x1F0F, -8, 1},
+        {0x1F18, 0x1F1D, -8, 1},
+        {0x1F28, 0x1F2F, -8, 1},
+        {0x1F38, 0x1F3F, -8, 1},
+        {0x1F48, 0x1F4D, -8, 1},
+        {0x1F59, 0x1F5F, -8, 2},
+        {0x1F68, 0x1F6F, -8, 1},
+        {0x1F88, 0x1F8F, -8, 1},
+        {0x1F98, 0x1F9F, -8, 1},
+        {0x1FA8, 0x1FAF, -8, 1},
+        {0x1FB8, 0x1FB9, -8, 1},
+        {0x1FBA, 0x1FBB, -74, 1},
+        {0x1FBC, 0x1FBC, -9, 1},
+        {0x1FC8, 0x1FCB, -86, 1},
+        {0x1FCC, 0x1FCC, -9, 1},
+        {0x1FD8, 0x1FD9, -8, 1},
+        {0x1FDA, 0x1FDB, -100, 1},
+        {0x1FE8, 0x1FE9, -8, 1},
+        {0x1FEA, 0x1FEB, -112, 1},
+        {0x1FEC, 0x1FEC, -7, 1},
+        {0x1FF8, 0x1FF9, -128, 1},
+        {0x1FFA, 0x1FFB, -126, 1},
+        {0x1FFC, 0x1FFC, -9, 1},
+        {0x2132, 0x2132, 28, 1},
+        {0x2160, 0x216F, 16, 1},
+        {0x2183, 0x2183, 1, 1},
+        {0x24B6, 0x24CF, 26, 1},
+        {0x2C00, 0x2C2F, 48, 1},
+        {0x2C60, 0x2C60, 1, 1},
+        {0x2C63, 0x2C63, -3814, 1},
+        {0x2C67, 0x2C6B, 1, 2},
+        {0x2C72, 0x2C72, 1, 1},
+        {0x2C75, 0x2C75, 1, 1},
+        {0x2C80, 0x2CE2, 1, 2},
+        {0x2CEB, 0x2CED, 1, 2},
+        {0x2CF2, 0x2CF2, 1, 1},
+        {0xA640, 0xA66C, 1, 2},
+        {0xA680, 0xA69A, 1, 2},
+        {0xA722, 0xA72E, 1, 2},
+        {0xA732, 0xA76E, 1, 2},
+        {0xA779, 0xA77B, 1, 2},
+        {0xA77D, 0xA77D, -35332, 1},
+        {0xA77E, 0xA786, 1, 2},
+        {0xA78B, 0xA78B, 1, 1},
+        {0xA790, 0xA792, 1, 2},
+        {0xA796, 0xA7A8, 1, 2},
+        {0xA7B3, 0xA7B3, 928, 1},
+        {0xA7B4, 0xA7C2, 1, 2},
+        {0xA7C4, 0xA7C4, -48, 1},
+        {0xA7C6, 0xA7C6, -35384, 1},
+        {0xA7C7, 0xA7C9, 1, 2},
+        {0xA7D0, 0xA7D0, 1, 1},
+        {0xA7D6, 0xA7D8, 1, 2},
+        {0xA7F5, 0xA7F5, 1, 1},
+        {0xAB70, 0xABBF, -38864, 1},
+        {0xFF21, 0xFF3A, 32, 1},
+    };
+
+    static bool isContinuation(unsigned char c) {
+        return (c & 0xc0) == 0x80;
+    }
+
+    /**
+     * @brief 复制并折叠从 pos 开始的 ASCII 字节，返回第一个非 ASCII 字节的位置
+     */
+    static size_t foldAscii(const unsigned char* src, size_t len, unsigned char* dst, size_t pos) {
+#if defined(__AVX2__)
+        const __m256i upperA = _mm256_set1_epi8('A' - 1);
+        const __m256i upperZ = _mm256_set1_epi8('Z' + 1);
+        const __m256i caseBit = _mm256_set1_epi8(0x20);
+        for (; pos + 32 <= len; pos += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos));
+            if (_mm256_movemask_epi8(bytes) != 0) {
+                break;
+            }
+            __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, upperA), _mm256_cmpgt_epi8(upperZ, bytes));
+            bytes = _mm256_or_si256(bytes, _mm256_and_si256(upper, caseBit));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + pos), bytes);
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i upperA16 = _mm_set1_epi8('A' - 1);
+        const __m128i upperZ16 = _mm_set1_epi8('Z' + 1);
+        const __m128i caseBit16 = _mm_set1_epi8(0x20);
+        for (; pos + 16 <= len; pos += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+            if (_mm_movemask_epi8(bytes) != 0) {
+                break;
+            }
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, upperA16), _mm_cmpgt_epi8(upperZ16, bytes));
+            bytes = _mm_or_si128(bytes, _mm_and_si128(upper, caseBit16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos), bytes);
+        }
+#endif
+        for (; pos < len && src[pos] < 0x80; ++pos) {
+            dst[pos] = foldCase(src[pos]);
+        }
+        return pos;
+    }
+
+    static uint32_t mapCodePoint(uint32_t cp) {
+        const FoldRange* end = std::end(kFoldRanges);
+        const FoldRange* range = std::upper_bound(std::begin(kFoldRanges), end, cp,
+                                                  [](uint32_t value, const FoldRange& r) { return value < r.first; });
+        if (range == std::begin(kFoldRanges)) {
+            return cp;
+        }
+        --range;
+        if (cp > range->last || (cp - range->first) % range->stride != 0) {
+            return cp;
+        }
+        return static_cast<uint32_t>(static_cast<int32_t>(cp) + range->delta);
+    }
+
+    static uint32_t foldThreeByte(uint32_t cp) {
+        // 过长编码（cp < 0x800）和代理区不做映射
+        if (cp < 0x800 || (cp >= 0xd800 && cp <= 0xdfff)) {
+            return cp;
+        }
+        return mapCodePoint(cp);
+    }
+
+    /**
+     * @brief U+0080~U+07FF 的折叠结果，首次使用时由区间表生成
+     */
+    static const std::array<uint16_t, 0x780>& twoByteTable() {
+        static const std::array<uint16_t, 0x780> table = [] {
+            std::array<uint16_t, 0x780> result{};
+            for (uint32_t cp = 0x80; cp < 0x800; ++cp) {
+                result[cp - 0x80] = static_cast<uint16_t>(mapCodePoint(cp));
+            }
+            return result;
+        }();
+        return table;
+    }
+};
+
+/**
+ * @brief 混淆归一化的开关
+ */
+struct NormalizationOptions {
+    bool leetspeak = true;       // 把形近的数字和符号映射为字母，如 sh1t；@ 和 * 可以代替元音，如 f@ck
+    bool collapseRepeats = true; // 正文中与上一个字母相同、且自动机没有对应转移的字母被跳过，如 fuuuck
+    bool stripSeparators = true; // 忽略字母之间的分隔符，如 f.u.c.k、f-u-c-k
+};
+
+/**
+ * @brief 混淆归一化 - 逐字节查表，把常见的变体写法还原为同一个形式
+ *
+ * 每个字节映射为一个归一化字节（同时做 ASCII 大小写折叠），或者被标记为分隔符而丢弃。
+ * 非 ASCII 字节原样保留。脏话用 normalize 预处理，正文则在扫描时逐字节套用同一张表
+ * （见 CompiledTrie::scanNormalized），不生成归一化后的副本。重复字母只在扫描正文时折叠：
+ * 与上一个字母相同、且自动机没有对应转移的字节被跳过，脏话本身不折叠，"ass" 仍然需要两个 s。
+ * 字符 @ 和 * 映射为通配符 kWildcard，由 variants 为脏话生成元音被替换的变体，扫描时仍是普通的单字节转移。
+ */
+class ObfuscationNormalizer {
+public:
+    static constexpr int kSeparator = -1;
+    static constexpr char kWildcard = '*';
+
+    explicit ObfuscationNormalizer(NormalizationOptions options = NormalizationOptions())
+        : settings(options), collapseRepeats(options.collapseRepeats), wildcards(options.leetspeak) {
+        for (int c = 0; c < 256; ++c) {
+            table[c] = static_cast<int16_t>(foldCase(static_cast<unsigned char>(c)));
+        }
+        if (options.leetspeak) {
+            static constexpr const char* kLeetspeak[][2] = {
+                {"4", "a"}, {"8", "b"}, {"(", "c"}, {"3", "e"}, {"69", "g"},
+                {"1!", "i"}, {"0", "o"}, {"$5", "s"}, {"7+", "t"}, {"@*", "*"},
+            };
+            for (const auto& entry : kLeetspeak) {
+                for (const char* from = entry[0]; *from != '\0'; ++from) {
+                    setMapping(*from, entry[1][0]);
+                }
+            }
+        }
+        if (options.stripSeparators) {
+            for (char c : std::string_view(".-_~,'`^/\\")) {
+                addSeparator(c);
+            }
+        }
+    }
+
+    /**
+     * @brief 自定义映射，应在加载词表前设置
+     */
+    void setMapping(char from, char to) {
+        table[static_cast<unsigned char>(from)] = static_cast<int16_t>(foldCase(static_cast<unsigned char>(to)));
+    }
+
+    void addSeparator(char c) {
+        table[static_cast<unsigned char>(c)] = kSeparator;
+    }
+
+    /**
+     * @brief 归一化后的字节，分隔符返回 kSeparator
+     */
+    int map(unsigned char c) const {
+        return table[c];
+    }
+
+    /**
+     * @brief 归一化字节是否属于单词；通配符代替的是字母，分隔符已被丢弃
+     */
+    static bool isWordByte(int c) {
+        return c == kWildcard || (c != kSeparator && ::isWordByte(static_cast<unsigned char>(c)));
+    }
+
+    /**
+     * @brief 正文中紧跟在相同字节之后的归一化字节 c 是否可以被折叠（自动机没有对应转移时才折叠）
+     */
+    bool collapses(int c) const {
+        return collapseRepeats && c < 0x80;
+    }
+
+    /**
+     * @brief 归一化整个字符串，用于预处理脏话；只映射字节和去掉分隔符，不折叠重复字母
+     */
+    std::string normalize(std::string_view word) const {
+        std::string result;
+        result.reserve(word.size());
+        for (char ch : word) {
+            int c = map(static_cast<unsigned char>(ch));
+            if (c != kSeparator) {
+                result.push_back(static_cast<char>(c));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief 归一化后的脏话及其元音被通配符替换的变体，最多替换两个元音，变体数与元音数的平方成正比
+     */
+    std::vector<std::string> variants(const std::string& normalized) const {
+        std::vector<std::string> result = {normalized};
+        if (!wildcards) {
+            return result;
+        }
+        std::vector<size_t> vowels;
+        for (size_t i = 0; i < normalized.size(); ++i) {
+            if (std::string_view("aeiou").find(normalized[i]) != std::string_view::npos) {
+                vowels.push_back(i);
+            }
+        }
+        for (size_t first = 0; first < vowels.size(); ++first) {
+            std::string one = normalized;
+            one[vowels[first]] = kWildcard;
+            result.push_back(normalize(one));
+            for (size_t second = first + 1; second < vowels.size(); ++second) {
+                std::string two = one;
+                two[vowels[second]] = kWildcard;
+                result.push_back(normalize(two));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief 构造时的开关；setMapping 和 addSeparator 做的修改不反映在这里
+     */
+    const NormalizationOptions& options() const {
+        return settings;
+    }
+
+    /**
+     * @brief 映射表和开关的 64 位指纹（FNV-1a），用于确认两个归一化器的行为相同
+     */
+    uint64_t fingerprint() const {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto mix = [&hash](unsigned char byte) {
+            hash = (hash ^ byte) * 0x100000001b3ull;
+        };
+        for (int16_t entry : table) {
+            mix(static_cast<unsigned char>(entry & 0xff));
+            mix(static_cast<unsigned char>((entry >> 8) & 0xff));
+        }
+        mix(collapseRepeats ? 1 : 0);
+        mix(wildcards ? 1 : 0);
+        return hash;
+    }
+
+private:
+    NormalizationOptions settings;
+    std::array<int16_t, 256> table;
+    bool collapseRepeats;
+    bool wildcards;
+};
+
+/**
+ * @brief 脏话对单词边界的要求
+ */
+enum class BoundaryMode : uint8_t {
+    Substring = 0, // 出现在任意位置即匹配，如 "ass" 匹配 "class"
+    Prefix = 1,    // 必须从单词开头开始，如 "ass" 匹配 "asshole"，不匹配 "class"
+    WholeWord = 2, // 前后都必须是单词边界，"ass" 不匹配 "asshole"
+};
+
+/**
+ * @brief 在 text 的 end 处结束的匹配是否满足 mode 的边界要求
+ * @param boundaryBefore 匹配起点之前是否是单词边界
+ */
+inline bool matchesBoundary(bool boundaryBefore, std::string_view text, size_t end, BoundaryMode mode) {
+    if (mode == BoundaryMode::Substring) {
+        return true;
+    }
+    return boundaryBefore && (mode == BoundaryMode::Prefix || end >= text.size() ||
+                              !isWordByte(static_cast<unsigned char>(text[end])));
+}
+
+/**
+ * @brief text 中 [start, start + length) 处的匹配是否满足 mode 的边界要求
+ */
+inline bool matchesBoundary(std::string_view text, size_t start, size_t length, BoundaryMode mode) {
+    bool boundaryBefore = start == 0 || !isWordByte(static_cast<unsigned char>(text[start - 1]));
+    return matchesBoundary(boundaryBefore, text, start + length, mode);
+}
+
+/**
+ * @brief 两个 64 位数相乘，返回 128 位乘积两半的异或（wyhash 的混合函数）
+ */
+inline uint64_t mixHash(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t product = a * b;
+    return product ^ (product >> 32) ^ ((a ^ b) >> 29);
+#endif
+}
+
+/**
+ * @brief 每次处理 16 个字节的 64 位哈希，短文本只需要一两次乘法；用于缓存和哈希表，不用于校验
+ */
+inline uint64_t hashBytes(const char* data, size_t size) {
+    constexpr uint64_t k0 = 0xa0761d6478bd642full;
+    constexpr uint64_t k1 = 0xe7037ed1a0b428dbull;
+    constexpr uint64_t k2 = 0x8ebc6af09c88c6e3ull;
+    uint64_t hash = k0 ^ size;
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint64_t a, b;
+        std::memcpy(&a, data + i, 8);
+        std::memcpy(&b, data + i + 8, 8);
+        hash = mixHash(a ^ k1, b ^ hash);
+    }
+    char tail[16] = {};
+    if (i < size) {
+        std::memcpy(tail, data + i, size - i);
+    }
+    uint64_t a, b;
+    std::memcpy(&a, tail, 8);
+    std::memcpy(&b, tail + 8, 8);
+    hash = mixHash(a ^ k1, b ^ hash);
+    return mixHash(hash ^ k2, size ^ k1);
+}
+
+/**
+ * @brief 最低的置位比特的下标，mask 不能为 0
+ */
+inline unsigned countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+inline unsigned countTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+    uint32_t low = static_cast<uint32_t>(mask);
+    return low != 0 ? countTrailingZeros(low) : 32 + countTrailingZeros(static_cast<uint32_t>(mask >> 32));
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+/**
+ * @brief 一次匹配在原文中的位置
+ */
+struct Match {
+    size_t offset;      // 起始字节偏移
+    size_t length;      // 长度（字节）
+    uint32_t patternId; // 命中的脏话/模式编号，由各过滤器按添加顺序分配
+};
+
+/**
+ * @brief 脏话的严重程度，按从轻到重排列
+ */
+enum class Severity : uint8_t {
+    None = 0,   // 没有脏话
+    Low = 1,    // 轻微，可以只记录不屏蔽
+    Medium = 2, // 需要屏蔽；未指定严重程度的脏话都是这一级
+    High = 3,   // 严重
+    Block = 4,  // 整条消息应被拒绝；classify 遇到即停止扫描
+};
+
+/**
+ * @brief 脏话的类别和严重程度，按脏话编号记录，随 saveCompiled 写入编译后的词典文件
+ */
+struct WordTag {
+    Severity severity = Severity::Medium;
+    uint8_t category = 0; // 由调用方定义，0 表示未分类
+};
+
+/**
+ * @brief classify 的结果：文本中最严重的脏话
+ */
+struct Classification {
+    Severity severity = Severity::None;
+    uint8_t category = 0;
+    Match match{0, 0, 0}; // 最先找到的最严重的匹配；不支持分级的过滤器不填写
+};
+
+/**
+ * @brief 固定大小的工作线程池，用于把批量任务分摊到多个核心
+ *
+ * parallelFor 把 [0, count) 切成大小为 grain 的块，由工作线程和调用线程一起领取，
+ * 调用线程在全部块完成后返回。多个线程可以同时对同一个线程池调用 parallelFor。
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threadCount 参与计算的线程总数（包括调用线程），0 表示使用硬件线程数
+     */
+    explicit ThreadPool(size_t threadCount = 0) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 1; i < threadCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief 参与计算的线程总数（包括调用线程）
+     */
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    /**
+     * @brief 并行执行 body(begin, end)，覆盖 [0, count) 的每个下标恰好一次
+     *
+     * body 抛出的第一个异常会在所有块结束后由调用线程重新抛出。
+     * 调用线程自己也领取块，只等待已经开始领取的辅助任务；调用线程做完所有块时还没有开始的
+     * 辅助任务直接跳过。因此可以在本线程池的任务中调用，即使所有工作线程都在忙也不会死锁。
+     */
+    template <typename Body>
+    void parallelFor(size_t count, size_t grain, Body&& body) {
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        size_t helpers = std::min(workers.size(), chunks > 0 ? chunks - 1 : 0);
+        if (helpers == 0) {
+            if (count > 0) {
+                body(size_t(0), count);
+            }
+            return;
+        }
+
+        // 辅助任务可能在 parallelFor 返回之后才被取出，共享状态由它们共同持有
+        struct Job {
+            std::atomic<size_t> next{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+            size_t active = 0;   // 已经开始领取块的辅助任务数
+            bool closed = false; // 调用线程已做完自己的部分，之后开始的辅助任务直接返回
+            std::exception_ptr error;
+        };
+        auto job = std::make_shared<Job>();
+
+        auto run = [&] {
+            for (;;) {
+                size_t begin = job->next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= count) {
+                    return;
+                }
+                try {
+                    body(begin, std::min(begin + grain, count));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    if (!job->error) {
+                        job->error = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (size_t i = 0; i < helpers; ++i) {
+                // closed 之后 run 和 body 不再被访问，引用捕获不会悬空
+                tasks.emplace_back([job, &run] {
+                    {
+                        std::lock_guard<std::mutex> lock(job->mutex);
+                        if (job->closed) {
+                            return;
+                        }
+                        ++job->active;
+                    }
+                    run();
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    if (--job->active == 0 && job->closed) {
+                        job->finished.notify_one();
+                    }
+                });
+            }
+        }
+        queueReady.notify_all();
+
+        run();
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->closed = true;
+        job->finished.wait(lock, [&] { return job->active == 0; });
+        if (job->error) {
+            std::rethrow_exception(job->error);
+        }
+    }
+
+    /**
+     * @brief 把一个独立任务交给工作线程执行，立即返回；没有工作线程时在调用线程中执行
+     *
+     * 任务不应抛出异常。析构线程池时会先执行完已提交的任务。
+     */
+    void submit(std::function<void()> task) {
+        if (workers.empty()) {
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push_back(std::move(task));
+        }
+        queueReady.notify_one();
+    }
+
+    /**
+     * @brief 进程内共享的默认线程池，线程数等于硬件线程数，首次使用时创建
+     */
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    bool stopping = false;
+
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+class CancellationSource;
+
+/**
+ * @brief 取消标志的只读视图，由 CancellationSource::token() 取得；默认构造的令牌永远不会被取消
+ */
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    bool cancelled() const {
+        return flag && flag->load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class CancellationSource;
+    std::shared_ptr<const std::atomic<bool>> flag;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag) : flag(std::move(flag)) {}
+};
+
+/**
+ * @brief 请求取消一组异步任务，如客户端断开后放弃尚未完成的 censorAsync
+ *
+ * 取消是协作式的：任务在开始前和处理过程中定期检查令牌，发现取消后尽早结束。
+ */
+class CancellationSource {
+public:
+    CancellationSource() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    CancellationToken token() const {
+        return CancellationToken(flag);
+    }
+
+    void cancel() {
+        flag->store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled() const {
+        return flag->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+/**
+ * @brief 统计信息中区分的查询类型
+ */
+enum class MetricsOperation : uint8_t {
+    Contains = 0,    // containsProfanity
+    Censor = 1,      // censorInPlace 及 censor / censorInto / censorTo / censorMask / censorBatch
+    FindMatches = 2, // findMatches
+};
+
+#if defined(PROFANITY_FILTER_METRICS)
+/**
+ * @brief 某个过滤器的统计信息，由 FilterMetrics::snapshot() 汇总各线程的计数得到
+ *
+ * 延迟直方图的第 k 个桶统计耗时小于 64 << k 纳秒（且不属于更小的桶）的调用，最后一个桶不设上限。
+ */
+struct MetricsSnapshot {
+    static constexpr size_t kOperations = 3;
+    static constexpr size_t kLatencyBuckets = 24;
+
+    std::array<uint64_t, kOperations> calls{};
+    std::array<uint64_t, kOperations> bytesScanned{};
+    std::array<uint64_t, kOperations> latencySumNs{};
+    std::array<std::array<uint64_t, kLatencyBuckets>, kOperations> latency{};
+    uint64_t matches = 0;
+    uint64_t prefilterRejects = 0;           // 预过滤器一次排除整条消息的次数
+    std::map<uint32_t, uint64_t> patternMatches; // 脏话编号 -> 命中次数
+
+    static constexpr uint64_t bucketUpperBoundNs(size_t bucket) {
+        return uint64_t(64) << bucket;
+    }
+
+    MetricsSnapshot& operator+=(const MetricsSnapshot& other) {
+        for (size_t op = 0; op < kOperations; ++op) {
+            calls[op] += other.calls[op];
+            bytesScanned[op] += other.bytesScanned[op];
+            latencySumNs[op] += other.latencySumNs[op];
+            for (size_t k = 0; k < kLatencyBuckets; ++k) {
+                latency[op][k] += other.latency[op][k];
+            }
+        }
+        matches += other.matches;
+        prefilterRejects += other.prefilterRejects;
+        for (const auto& [pattern, count] : other.patternMatches) {
+            patternMatches[pattern] += count;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief 以 Prometheus 文本格式输出一组过滤器的统计信息，每项以 filter 标签区分
+     * @param filters (filter 标签, 统计信息) 列表
+     */
+    static void writePrometheus(std::ostream& out,
+                                const std::vector<std::pair<std::string, MetricsSnapshot>>& filters) {
+        static constexpr const char* kOperationNames[kOperations] = {"contains", "censor", "find_matches"};
+        auto perOperation = [&](const char* name, const char* type, auto&& value) {
+            out << "# TYPE profanity_filter_" << name << ' ' << type << '\n';
+            for (const auto& [filter, snapshot] : filters) {
+                for (size_t op = 0; op < kOperations; ++op) {
+                    out << "profanity_filter_" << name << "{filter=\"" << filter << "\",operation=\""
+                        << kOperationNames[op] << "\"} " << value(snapshot, op) << '\n';
+                }
+            }
+        };
+        perOperation("calls_total", "counter", [](const MetricsSnapshot& s, size_t op) { return s.calls[op]; });
+        perOperation("bytes_scanned_total", "counter",
+                     [](const MetricsSnapshot& s, size_t op) { return s.bytesScanned[op]; });
+
+        out << "# TYPE profanity_filter_matches_total counter\n";
+        for (const auto& [filter, snapshot] : filters) {
+            out << "profanity_filter_matches_total{filter=\"" << filter << "\"} " << snapshot.matches << '\n';
+        }
+        out << "# TYPE profanity_filter_prefilter_rejects_total counter\n";
+        for (const auto& [filter, snapshot] : filters) {
+            out << "profanity_filter_prefilter_rejects_total{filter=\"" << filter << "\"} "
+                << snapshot.prefilterRejects << '\n';
+        }
+        out << "# TYPE profanity_filter_pattern_matches_total counter\n";
+        for (const auto& [filter, snapshot] : filters) {
+            for (const auto& [pattern, count] : snapshot.patternMatches) {
+                out << "profanity_filter_pattern_matches_total{filter=\"" << filter << "\",pattern=\"" << pattern
+                    << "\"} " << count << '\n';
+            }
+        }
+
+        out << "# TYPE profanity_filter_latency_seconds histogram\n";
+        for (const auto& [filter, snapshot] : filters) {
+            for (size_t op = 0; op < kOperations; ++op) {
+                std::string labels = "filter=\"" + filter + "\",operation=\"" + kOperationNames[op] + "\"";
+                uint64_t cumulative = 0;
+                for (size_t k = 0; k + 1 < kLatencyBuckets; ++k) {
+                    cumulative += snapshot.latency[op][k];
+                    out << "profanity_filter_latency_seconds_bucket{" << labels << ",le=\""
+                        << static_cast<double>(bucketUpperBoundNs(k)) * 1e-9 << "\"} " << cumulative << '\n';
+                }
+                out << "profanity_filter_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} "
+                    << snapshot.calls[op] << '\n';
+                out << "profanity_filter_latency_seconds_sum{" << labels << "} "
+                    << static_cast<double>(snapshot.latencySumNs[op]) * 1e-9 << '\n';
+                out << "profanity_filter_latency_seconds_count{" << labels << "} " << snapshot.calls[op] << '\n';
+            }
+        }
+    }
+};
+
+/**
+ * @brief 过滤器的运行时统计 - 每个线程写自己的计数分片，查询时才汇总
+ *
+ * 热路径上只有本线程分片上的普通读写（relaxed 原子变量，没有读-改-写，也没有其他线程竞争）。
+ * 每个线程有一张 thread_local 的表，按过滤器编号找到本线程的分片，表的大小不受限制；
+ * 只有线程第一次使用某个过滤器时才加锁登记新的分片，之后的查询不访问共享状态。
+ * 线程退出时把它的分片并入各过滤器的汇总并释放；已销毁过滤器的表项在表增长时顺带清理。
+ * 脏话编号的命中次数放在分片的互斥锁下，只有本次调用有匹配时才加锁一次。
+ * 复制过滤器时统计信息不随之复制。
+ */
+class FilterMetrics {
+public:
+    struct Shard {
+        using Counter = std::atomic<uint64_t>;
+
+        std::array<Counter, MetricsSnapshot::kOperations> calls{};
+        std::array<Counter, MetricsSnapshot::kOperations> bytesScanned{};
+        std::array<Counter, MetricsSnapshot::kOperations> latencySumNs{};
+        std::array<std::array<Counter, MetricsSnapshot::kLatencyBuckets>, MetricsSnapshot::kOperations> latency{};
+        Counter matches{0};
+        Counter prefilterRejects{0};
+
+        mutable std::mutex patternMutex;
+        std::unordered_map<uint32_t, uint64_t> patternMatches;
+
+        // 只有所属线程写入，不需要 fetch_add
+        static void add(Counter& counter, uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+    };
+
+    FilterMetrics() : id(nextId.fetch_add(1, std::memory_order_relaxed)), state(std::make_shared<State>()) {}
+
+    FilterMetrics(const FilterMetrics&) : FilterMetrics() {}
+
+    FilterMetrics& operator=(const FilterMetrics&) {
+        return *this;
+    }
+
+    /**
+     * @brief 当前线程的分片
+     */
+    Shard& localShard() {
+        ThreadShards& local = threadShards();
+        if (local.lastId == id) {
+            return *local.last;
+        }
+        auto it = local.entries.find(id);
+        Shard* shard = it != local.entries.end() ? it->second.shard : local.add(id, state);
+        local.lastId = id;
+        local.last = shard;
+        return *shard;
+    }
+
+    /**
+     * @brief 汇总所有线程的计数；可以与查询并发调用
+     */
+    MetricsSnapshot snapshot() const {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        MetricsSnapshot result = state->retired;
+        for (const auto& shard : state->shards) {
+            accumulate(*shard, result);
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t kSweepInterval = 64;
+    static constexpr uint64_t kNoFilter = ~uint64_t(0);
+    static inline std::atomic<uint64_t> nextId{0};
+
+    // 过滤器的分片和已退出线程的计数；线程退出时过滤器可能已经销毁，因此单独共享
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+        MetricsSnapshot retired;
+
+        void retire(const Shard* shard) {
+            std::lock_guard<std::mutex> lock(mutex);
+            accumulate(*shard, retired);
+            shards.erase(std::find_if(shards.begin(), shards.end(),
+                                      [shard](const std::unique_ptr<Shard>& owned) { return owned.get() == shard; }));
+        }
+    };
+
+    // 每个线程一份：过滤器编号 -> 本线程在该过滤器中的分片
+    struct ThreadShards {
+        struct Entry {
+            std::weak_ptr<State> owner;
+            Shard* shard;
+        };
+
+        std::unordered_map<uint64_t, Entry> entries;
+        uint64_t lastId = kNoFilter; // 最近一次使用的过滤器，连续查询同一个过滤器时不查表
+        Shard* last = nullptr;
+        size_t sweepAt = kSweepInterval;
+
+        Shard* add(uint64_t id, const std::shared_ptr<State>& state) {
+            if (entries.size() >= sweepAt) {
+                // 编号不会重复，已销毁过滤器的表项不会被误用，只是占用空间
+                for (auto it = entries.begin(); it != entries.end();) {
+                    it = it->second.owner.expired() ? entries.erase(it) : std::next(it);
+                }
+                sweepAt = std::max(kSweepInterval, 2 * entries.size());
+            }
+            auto shard = std::make_unique<Shard>();
+            Shard* raw = shard.get();
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->shards.push_back(std::move(shard));
+            }
+            entries.emplace(id, Entry{state, raw});
+            return raw;
+        }
+
+        ~ThreadShards() {
+            for (const auto& [id, entry] : entries) {
+                if (std::shared_ptr<State> owner = entry.owner.lock()) {
+                    owner->retire(entry.shard);
+                }
+            }
+        }
+    };
+
+    static ThreadShards& threadShards() {
+        thread_local ThreadShards local;
+        return local;
+    }
+
+    static void accumulate(const Shard& shard, MetricsSnapshot& result) {
+        for (size_t op = 0; op < MetricsSnapshot::kOperations; ++op) {
+            result.calls[op] += shard.calls[op].load(std::memory_order_relaxed);
+            result.bytesScanned[op] += shard.bytesScanned[op].load(std::memory_order_relaxed);
+            result.latencySumNs[op] += shard.latencySumNs[op].load(std::memory_order_relaxed);
+            for (size_t k = 0; k < MetricsSnapshot::kLatencyBuckets; ++k) {
+                result.latency[op][k] += shard.latency[op][k].load(std::memory_order_relaxed);
+            }
+        }
+        result.matches += shard.matches.load(std::memory_order_relaxed);
+        result.prefilterRejects += shard.prefilterRejects.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> patternLock(shard.patternMutex);
+        for (const auto& [pattern, count] : shard.patternMatches) {
+            result.patternMatches[pattern] += count;
+        }
+    }
+
+    const uint64_t id; // 进程内唯一，用于在 thread_local 表中查找分片
+    std::shared_ptr<State> state;
+};
+
+/**
+ * @brief 记录一次查询：构造时开始计时，析构时把调用次数、字节数和耗时计入当前线程的分片
+ *
+ * 同一个过滤器的查询在内部调用自己的其他查询（如 censorInPlace 调用 findMatches）时，
+ * 内层的记录不再计数，匹配交给外层记录，每次外部调用只计一次。
+ */
+class MetricsScope {
+public:
+    MetricsScope(FilterMetrics& metrics, MetricsOperation operation, size_t bytes)
+        : metrics(metrics), operation(static_cast<size_t>(operation)), bytes(bytes) {
+        for (outer = active; outer != nullptr; outer = outer->previous) {
+            if (&outer->metrics == &metrics) {
+                return; // 嵌套调用
+            }
+        }
+        shard = &metrics.localShard();
+        start = std::chrono::steady_clock::now();
+        active = this;
+    }
+
+    MetricsScope(const MetricsScope&) = delete;
+    MetricsScope& operator=(const MetricsScope&) = delete;
+
+    ~MetricsScope() {
+        if (shard == nullptr) {
+            return;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        size_t bucket = 0;
+        for (uint64_t rest = ns >> 6; rest != 0 && bucket + 1 < MetricsSnapshot::kLatencyBuckets; rest >>= 1) {
+            ++bucket;
+        }
+        FilterMetrics::Shard::add(shard->calls[operation], 1);
+        FilterMetrics::Shard::add(shard->bytesScanned[operation], bytes);
+        FilterMetrics::Shard::add(shard->latencySumNs[operation], ns);
+        FilterMetrics::Shard::add(shard->latency[operation][bucket], 1);
+        active = previous;
+    }
+
+    /**
+     * @brief 记录一次命中；本次调用第一次命中时锁定分片的编号计数，直到调用结束
+     */
+    void match(uint32_t patternId) {
+        if (shard == nullptr) {
+            outer->match(patternId);
+            return;
+        }
+        if (!patternLock.owns_lock()) {
+            patternLock = std::unique_lock<std::mutex>(shard->patternMutex);
+        }
+        FilterMetrics::Shard::add(shard->matches, 1);
+        ++shard->patternMatches[patternId];
+    }
+
+    void matches(const Match* first, const Match* last) {
+        for (; first != last; ++first) {
+            match(first->patternId);
+        }
+    }
+
+    /**
+     * @brief 预过滤器排除了整条消息
+     */
+    void prefilterRejected() {
+        if (shard == nullptr) {
+            outer->prefilterRejected();
+            return;
+        }
+        FilterMetrics::Shard::add(shard->prefilterRejects, 1);
+    }
+
+private:
+    static inline thread_local MetricsScope* active = nullptr; // 当前线程最内层的有效记录
+
+    FilterMetrics& metrics;
+    MetricsScope* outer = nullptr;         // 嵌套调用时指向外层同一个过滤器的记录
+    MetricsScope* previous = active;       // 外层其他过滤器的记录，析构时恢复
+    FilterMetrics::Shard* shard = nullptr; // 为空表示嵌套调用
+    size_t operation;
+    size_t bytes;
+    std::chrono::steady_clock::time_point start;
+    std::unique_lock<std::mutex> patternLock;
+};
+#else
+/**
+ * @brief 未定义 PROFANITY_FILTER_METRICS 时的空记录，调用全部被编译器消除
+ */
+class MetricsScope {
+public:
+    ~MetricsScope() {} // 与启用时一样有析构函数，未使用的变量不会产生警告
+
+    void match(uint32_t) {}
+    void matches(const Match*, const Match*) {}
+    void prefilterRejected() {}
+};
+#endif
+
+/**
+ * @brief 脏话屏蔽基类，定义统一接口
+ */
+class ProfanityFilter {
+public:
+    virtual ~ProfanityFilter() = default;
+    
+    /**
+     * @brief 检测文本中是否包含脏话
+     * @param text 待检测文本
+     * @return true 如果包含脏话
+     */
+    virtual bool containsProfanity(std::string_view text) const = 0;
+
+    bool containsProfanity(const std::string& text) const {
+        return containsProfanity(std::string_view(text));
+    }
+
+    bool containsProfanity(const char* text) const {
+        return containsProfanity(std::string_view(text));
+    }
+    
+    /**
+     * @brief 屏蔽文本中的脏话
+     * @param text 待处理文本
+     * @return 处理后的文本
+     */
+    virtual std::string censor(std::string_view text) const {
+        std::string result(text);
+        censorInPlace(result.data(), result.size());
+        return result;
+    }
+
+    std::string censor(const std::string& text) const {
+        return censor(std::string_view(text));
+    }
+
+    std::string censor(const char* text) const {
+        return censor(std::string_view(text));
+    }
+
+    /**
+     * @brief 直接在调用方的缓冲区内屏蔽脏话，不分配新字符串
+     * @param buf 待处理文本，处理结果写回原处
+     * @param len 文本长度（字节）
+     */
+    virtual void censorInPlace(char* buf, size_t len) const = 0;
+
+    /**
+     * @brief 将屏蔽结果写入 out，复用 out 已有的容量
+     * @param text 待处理文本
+     * @param out 输出字符串
+     */
+    void censorInto(std::string_view text, std::string& out) const {
+        out.assign(text.data(), text.size());
+        censorInPlace(out.data(), out.size());
+    }
+
+    /**
+     * @brief 将屏蔽结果写入调用方提供的缓冲区，不分配内存
+     * @param out 输出缓冲区，可以与 text 是同一块内存
+     * @param cap out 的容量（字节）
+     * @return false 如果 cap 小于 text.size()，此时不写入 out
+     */
+    bool censorTo(std::string_view text, char* out, size_t cap) const {
+        if (cap < text.size()) {
+            return false;
+        }
+        if (out != text.data() && !text.empty()) {
+            std::memmove(out, text.data(), text.size());
+        }
+        censorInPlace(out, text.size());
+        return true;
+    }
+
+    /**
+     * @brief 只给出要屏蔽的位置，不生成屏蔽后的文本
+     *
+     * mask 调整为 (text.size() + 63) / 64 个字，第 i 字节要屏蔽时第 i % 64 位（字 i / 64）为 1。
+     * 已有的容量会被复用，调用方可以在写出响应时用 isMasked / applyMask 直接替换，不需要中间字符串。
+     * 默认实现在当前线程复用的缓冲区内屏蔽一份副本再逐字节比较，原文本来就是替换字符的位置
+     * 可能不置位，应用掩码的结果与 censor 相同；能直接给出匹配区间的过滤器会覆盖它。
+     * @param text 待处理文本
+     * @param mask 输出的位掩码
+     */
+    virtual void censorMask(std::string_view text, std::vector<uint64_t>& mask) const {
+        mask.assign(maskWords(text.size()), 0);
+        thread_local std::string copy;
+        copy.assign(text.data(), text.size());
+        censorInPlace(copy.data(), copy.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (copy[i] != text[i]) {
+                mask[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    /**
+     * @brief censorMask 给出的掩码中第 i 字节是否要屏蔽
+     */
+    static bool isMasked(const std::vector<uint64_t>& mask, size_t i) {
+        return (mask[i / 64] >> (i % 64)) & 1;
+    }
+
+    /**
+     * @brief 按掩码把 text 写入 out，要屏蔽的字节写为 replacementChar
+     *
+     * 掩码为 0 的整字直接复制。out 至少有 text.size() 字节，可以与 text 是同一块内存。
+     */
+    static void applyMask(std::string_view text, const std::vector<uint64_t>& mask, char replacementChar,
+                          char* out) {
+        for (size_t word = 0; word * 64 < text.size(); ++word) {
+            size_t begin = word * 64;
+            size_t count = std::min<size_t>(64, text.size() - begin);
+            if (out != text.data()) {
+                std::memmove(out + begin, text.data() + begin, count);
+            }
+            for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+                out[begin + countTrailingZeros(bits)] = replacementChar;
+            }
+        }
+    }
+
+    /**
+     * @brief 批量屏蔽，把一批消息分摊到线程池的各个线程上
+     *
+     * 过滤器在查询期间只读，所有线程共享同一个实例。out 调整为 count 个元素，
+     * out[i] 是 in[i] 的屏蔽结果，已有元素的容量会被复用。
+     * @param in 待处理文本数组
+     * @param count 文本个数
+     * @param out 输出
+     * @param pool 执行批量任务的线程池，默认使用 ThreadPool::shared()
+     */
+    void censorBatch(const std::string_view* in, size_t count, std::vector<std::string>& out,
+                     ThreadPool& pool = ThreadPool::shared()) const {
+        out.resize(count);
+        pool.parallelFor(count, kBatchGrain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                censorInto(in[i], out[i]);
+            }
+        });
+    }
+
+    void censorBatch(const std::vector<std::string_view>& in, std::vector<std::string>& out,
+                     ThreadPool& pool = ThreadPool::shared()) const {
+        censorBatch(in.data(), in.size(), out, pool);
+    }
+
+#if defined(__cpp_lib_span)
+    void censorBatch(std::span<const std::string_view> in, std::vector<std::string>& out,
+                     ThreadPool& pool = ThreadPool::shared()) const {
+        censorBatch(in.data(), in.size(), out, pool);
+    }
+#endif
+
+    // 不超过该长度的文本由 censorAsync 在调用线程中直接处理，调度开销比屏蔽本身更大
+    static constexpr size_t kAsyncInlineBytes = 16 * 1024;
+
+    using CensorCallback = std::function<void(std::optional<std::string>)>;
+
+    /**
+     * @brief 异步屏蔽，避免长文本阻塞事件循环线程
+     *
+     * 不超过 inlineLimit 的文本在调用线程中处理，返回前调用 done；更长的文本交给 pool 的工作线程，
+     * done 在工作线程中调用，需要回到事件循环时由 done 自己投递。
+     * 被取消时 done 收到 std::nullopt。任务完成前过滤器必须保持有效且不被修改。
+     * @param text 待处理文本，交给工作线程时随任务移动，调用方不需要保持原文有效
+     * @param done 完成回调，收到屏蔽结果
+     * @param token 取消令牌，取消后尚未开始的任务不再执行，正在执行的任务尽早结束
+     */
+    void censorAsync(std::string text, CensorCallback done, CancellationToken token = {},
+                     ThreadPool& pool = ThreadPool::shared(), size_t inlineLimit = kAsyncInlineBytes) const {
+        if (text.size() <= inlineLimit) {
+            done(censorOrCancel(text, token));
+            return;
+        }
+        pool.submit([this, text = std::move(text), done = std::move(done), token = std::move(token)] {
+            done(censorOrCancel(text, token));
+        });
+    }
+
+#if defined(PROFANITY_FILTER_HAS_COROUTINES)
+    class CensorAwaitable;
+
+    /**
+     * @brief censorAsync 的协程版本：co_await 得到屏蔽结果，被取消时为 std::nullopt
+     *
+     * 短文本不挂起协程；长文本交给 pool 的工作线程，协程在该工作线程中恢复。
+     */
+    CensorAwaitable censorAsync(std::string text, CancellationToken token = {},
+                                ThreadPool& pool = ThreadPool::shared(),
+                                size_t inlineLimit = kAsyncInlineBytes) const;
+#endif
+
+    /**
+     * @brief 可以中途取消的屏蔽，censorAsync 使用
+     *
+     * 默认实现只在开始前检查 token；能够分段扫描的过滤器在处理过程中定期检查。
+     * @param out 输出，复用已有的容量
+     * @return false 如果被取消，此时 out 的内容不确定
+     */
+    virtual bool censorCancellable(std::string_view text, std::string& out, const CancellationToken& token) const {
+        if (token.cancelled()) {
+            return false;
+        }
+        censorInto(text, out);
+        return true;
+    }
+
+    /**
+     * @brief 查找文本中所有要屏蔽的区间，不修改文本
+     *
+     * 只需要判断或记录日志的调用方可以跳过屏蔽步骤。
+     * @param text 待检测文本
+     * @param matches 匹配结果追加到末尾，按过滤器自身的扫描顺序排列
+     */
+    virtual void findMatches(std::string_view text, std::vector<Match>& matches) const = 0;
+    
+    /**
+     * @brief 添加脏话到过滤列表
+     * @param word 脏话
+     */
+    virtual void addProfanity(const std::string& word) = 0;
+
+    /**
+     * @brief 添加脏话，并指定它对单词边界的要求
+     *
+     * 边界在匹配过程中检查，不需要对结果再做一遍过滤。
+     * @param boundary 边界要求，addProfanity(word) 相当于 BoundaryMode::Substring
+     */
+    virtual void addProfanity(const std::string& word, BoundaryMode boundary) = 0;
+
+    /**
+     * @brief 添加白名单短语（如 "Scunthorpe"、"assassin"）
+     *
+     * 与白名单短语的某次出现重叠的匹配都不屏蔽，忽略大小写。
+     * @param phrase 白名单短语
+     */
+    virtual void addAllowedPhrase(const std::string& phrase) = 0;
+    
+    /**
+     * @brief 从文件加载脏话列表
+     * @param filename 文件名
+     */
+    virtual void loadFromFile(const std::string& filename) = 0;
+
+    /**
+     * @brief 提前完成查询所需的所有延迟构建（如自动机编译）
+     *
+     * 词表加载完成后调用，之后的第一次查询不会再等待编译。
+     */
+    virtual void compile() {}
+
+    /**
+     * @brief 给出文本中最严重的脏话，遇到 Severity::Block 级的脏话即停止扫描
+     *
+     * 调用方可以据此直接拒绝消息，只在需要时再调用 censor。
+     * 默认实现不区分严重程度：有脏话时返回 Severity::Medium。
+     */
+    virtual Classification classify(std::string_view text) const {
+        Classification result;
+        if (containsProfanity(text)) {
+            result.severity = Severity::Medium;
+        }
+        return result;
+    }
+
+#if defined(PROFANITY_FILTER_METRICS)
+    /**
+     * @brief 汇总该过滤器在各线程上的统计信息（定义 PROFANITY_FILTER_METRICS 时提供）
+     */
+    virtual MetricsSnapshot metricsSnapshot() const {
+        return metrics.snapshot();
+    }
+#endif
+
+protected:
+    // 每次从线程池领取的消息数，分摊调度开销，同时保持负载均衡
+    static constexpr size_t kBatchGrain = 64;
+
+    static size_t maskWords(size_t length) {
+        return (length + 63) / 64;
+    }
+
+    /**
+     * @brief 把掩码中 [start, start + length) 的位置为 1，中间的整字直接填满
+     */
+    static void markMask(std::vector<uint64_t>& mask, size_t start, size_t length) {
+        size_t end = start + length;
+        while (start < end) {
+            size_t bit = start % 64;
+            size_t count = std::min<size_t>(64 - bit, end - start);
+            uint64_t bits = count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1) << bit;
+            mask[start / 64] |= bits;
+            start += count;
+        }
+    }
+
+    /**
+     * @brief 从当前线程的缓冲池借一个空的匹配数组，作用域结束时归还
+     *
+     * 先收集匹配再统一替换的 censorInPlace 用它代替局部数组，容量留在池中复用，
+     * 稳定后不再分配内存。嵌套的调用借到的是不同的数组。
+     */
+    class ScratchMatches {
+    public:
+        ScratchMatches() : depth(level++) {
+            if (pool.size() <= depth) {
+                pool.emplace_back(); // deque 在尾部追加不会使外层借到的数组失效
+            }
+            pool[depth].clear();
+        }
+
+        ~ScratchMatches() {
+            --level;
+        }
+
+        ScratchMatches(const ScratchMatches&) = delete;
+        ScratchMatches& operator=(const ScratchMatches&) = delete;
+
+        std::vector<Match>& get() {
+            return pool[depth];
+        }
+
+    private:
+        static inline thread_local std::deque<std::vector<Match>> pool;
+        static inline thread_local size_t level = 0;
+        const size_t depth;
+    };
+
+#if defined(PROFANITY_FILTER_METRICS)
+    mutable FilterMetrics metrics;
+
+    /**
+     * @brief 开始记录一次查询，返回的对象在作用域结束时计入统计
+     */
+    MetricsScope recordCall(MetricsOperation operation, size_t bytes) const {
+        return MetricsScope(metrics, operation, bytes);
+    }
+#else
+    MetricsScope recordCall(MetricsOperation, size_t) const {
+        return {};
+    }
+#endif
+
+    /**
+     * @brief 忽略大小写在 text 中从 from 开始查找已转为小写的 word
+     */
+    static size_t findIgnoreCase(std::string_view text, std::string_view word, size_t from) {
+        if (word.empty() || from > text.size()) {
+            return std::string_view::npos;
+        }
+        auto it = std::search(text.begin() + from, text.end(), word.begin(), word.end(),
+                              [](char a, char b) {
+                                  return foldCase(static_cast<unsigned char>(a)) ==
+                                         static_cast<unsigned char>(b);
+                              });
+        return it == text.end() ? std::string_view::npos : static_cast<size_t>(it - text.begin());
+    }
+
+    /**
+     * @brief 去掉 matches 中从 first 开始、与某个白名单短语的出现位置重叠的匹配
+     *
+     * 只在每个匹配附近查找白名单短语，不重新扫描全文；供没有自动机的过滤器使用。
+     * @param phrases 已转为小写的白名单短语
+     */
+    static void removeAllowed(std::string_view text, std::vector<Match>& matches, size_t first,
+                              const std::vector<std::string>& phrases) {
+        if (phrases.empty()) {
+            return;
+        }
+        auto overlapsAllowed = [&](const Match& match) {
+            for (const std::string& phrase : phrases) {
+                // 与匹配重叠的出现位置都落在 [from, to) 之内
+                size_t from = match.offset + 1 > phrase.size() ? match.offset + 1 - phrase.size() : 0;
+                size_t to = std::min(text.size(), match.offset + match.length + phrase.size() - 1);
+                if (findIgnoreCase(text.substr(0, to), phrase, from) != std::string_view::npos) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        matches.erase(std::remove_if(matches.begin() + first, matches.end(), overlapsAllowed), matches.end());
+    }
+
+    std::optional<std::string> censorOrCancel(std::string_view text, const CancellationToken& token) const {
+        std::string out;
+        if (!censorCancellable(text, out, token)) {
+            return std::nullopt;
+        }
+        return out;
+    }
+
+    /**
+     * @brief 将匹配区间替换为指定字符
+     */
+    static void applyMatches(char* buf, size_t len, const std::vector<Match>& matches,
+                             char replacementChar) {
+        for (const auto& match : matches) {
+            for (size_t i = 0; i < match.length && match.offset + i < len; ++i) {
+                buf[match.offset + i] = replacementChar;
+            }
+        }
+    }
+};
+
+#if defined(PROFANITY_FILTER_HAS_COROUTINES)
+/**
+ * @brief ProfanityFilter::censorAsync 返回的等待对象，只能 co_await 一次
+ */
+class ProfanityFilter::CensorAwaitable {
+public:
+    CensorAwaitable(const ProfanityFilter& filter, std::string text, CancellationToken token, ThreadPool& pool,
+                    size_t inlineLimit)
+        : filter(filter), text(std::move(text)), token(std::move(token)), pool(pool), inlineLimit(inlineLimit) {}
+
+    bool await_ready() {
+        if (text.size() > inlineLimit) {
+            return false;
+        }
+        result = filter.censorOrCancel(text, token);
+        return true;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        pool.submit([this, handle] {
+            result = filter.censorOrCancel(text, token);
+            handle.resume();
+        });
+    }
+
+    std::optional<std::string> await_resume() {
+        return std::move(result);
+    }
+
+private:
+    const ProfanityFilter& filter;
+    std::string text;
+    CancellationToken token;
+    ThreadPool& pool;
+    size_t inlineLimit;
+    std::optional<std::string> result;
+};
+
+inline ProfanityFilter::CensorAwaitable ProfanityFilter::censorAsync(std::string text, CancellationToken token,
+                                                                     ThreadPool& pool, size_t inlineLimit) const {
+    return CensorAwaitable(*this, std::move(text), std::move(token), pool, inlineLimit);
+}
+#endif
+
+/**
+ * @brief 首字节预过滤器 - 快速跳过不可能作为脏话起点的位置
+ *
+ * 记录所有脏话的首字节集合和前两个字节组合。扫描时先用向量指令一次检查
+ * 16/32 个字节（编译时开启 SSSE3/AVX2，如 -march=native），否则逐字节查表，
+ * 只有通过检查的候选位置才交给字典树/自动机。大多数干净文本在这一步就被排除。
+ * 大小写与 foldCase 一致：记录小写字节，同时接受对应的大写字母。
+ */
+class FirstBytePrefilter {
+public:
+    FirstBytePrefilter() : bigrams(kBigramWords, 0) {}
+
+    /**
+     * @brief 记录一个已转为小写的脏话
+     */
+    void addWord(std::string_view word) {
+        if (word.empty()) {
+            return;
+        }
+
+        unsigned char first = static_cast<unsigned char>(word[0]);
+        addFirstByte(first);
+        if (first >= 'a' && first <= 'z') {
+            addFirstByte(static_cast<unsigned char>(first - ('a' - 'A')));
+        }
+
+        if (word.length() == 1) {
+            setBit(singleBytes.data(), first);
+        } else {
+            setBit(bigrams.data(), bigramIndex(first, static_cast<unsigned char>(word[1])));
+        }
+    }
+
+    bool empty() const {
+        for (uint64_t bits : firstBytes) {
+            if (bits != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 查找不小于 from 的第一个候选起始位置
+     * @return 候选位置，没有时返回 len
+     */
+    size_t nextCandidate(const char* data, size_t len, size_t from) const {
+        return findCandidate(lowNibbles, data, len, from,
+                             [this](const char* text, size_t size, size_t pos) { return isCandidate(text, size, pos); });
+    }
+
+    /**
+     * @brief 向量化的候选位置查找，供其他首字节表（如 StaticTrieTable）共用
+     *
+     * 先用半字节表一次排除 16/32 个字节，通过的位置再交给 isCandidate(data, len, pos) 精确判断。
+     * @param lowNibbles 由 addNibble 记录了所有首字节的低半字节表
+     */
+    template <typename IsCandidate>
+    static size_t findCandidate([[maybe_unused]] const std::array<uint8_t, 16>& lowNibbles, const char* data,
+                                size_t len, size_t from, IsCandidate&& isCandidate) {
+        size_t pos = from;
+#if defined(__AVX2__)
+        const __m256i lowTable = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowNibbles.data())));
+        const __m256i highTable = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(kHighNibbles.data())));
+        const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        for (; pos + 32 <= len; pos += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i low = _mm256_and_si256(bytes, nibbleMask);
+            __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibbleMask);
+            __m256i hit = _mm256_and_si256(_mm256_shuffle_epi8(lowTable, low),
+                                           _mm256_shuffle_epi8(highTable, high));
+            uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, zero)));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t candidate = pos + countTrailingZeros(mask);
+                if (isCandidate(data, len, candidate)) {
+                    return candidate;
+                }
+            }
+        }
+#elif defined(__SSSE3__)
+        const __m128i lowTable = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowNibbles.data()));
+        const __m128i highTable = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kHighNibbles.data()));
+        const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+        const __m128i zero = _mm_setzero_si128();
+        for (; pos + 16 <= len; pos += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i low = _mm_and_si128(bytes, nibbleMask);
+            __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+            __m128i hit = _mm_and_si128(_mm_shuffle_epi8(lowTable, low),
+                                        _mm_shuffle_epi8(highTable, high));
+            uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hit, zero))) & 0xffffu;
+            for (; mask != 0; mask &= mask - 1) {
+                size_t candidate = pos + countTrailingZeros(mask);
+                if (isCandidate(data, len, candidate)) {
+                    return candidate;
+                }
+            }
+        }
+#endif
+        for (; pos < len; ++pos) {
+            if (isCandidate(data, len, pos)) {
+                return pos;
+            }
+        }
+        return len;
+    }
+
+    /**
+     * @brief 在低半字节表中记录首字节 c
+     */
+    static constexpr void addNibble(std::array<uint8_t, 16>& lowNibbles, unsigned char c) {
+        lowNibbles[c & 0x0f] |= static_cast<uint8_t>(1u << ((c >> 4) & 7));
+    }
+
+    /**
+     * @brief 只看首字节时，c 是否可能是某个脏话的开头
+     */
+    bool mayStart(unsigned char c) const {
+        return testBit(firstBytes.data(), c);
+    }
+
+    /**
+     * @brief 检查 pos 处的首字节和前两个字节是否可能构成某个脏话的开头
+     */
+    bool isCandidate(const char* data, size_t len, size_t pos) const {
+        unsigned char first = static_cast<unsigned char>(data[pos]);
+        if (!testBit(firstBytes.data(), first)) {
+            return false;
+        }
+
+        unsigned char lowerFirst = foldCase(first);
+        if (testBit(singleBytes.data(), lowerFirst)) {
+            return true;
+        }
+        if (pos + 1 >= len) {
+            return false;
+        }
+        unsigned char second = foldCase(static_cast<unsigned char>(data[pos + 1]));
+        return testBit(bigrams.data(), bigramIndex(lowerFirst, second));
+    }
+
+private:
+    static constexpr size_t kBigramWords = 65536 / 64;
+
+    // 向量路径使用的半字节表：低半字节表的第 (高半字节 & 7) 位表示该组合存在。
+    // 高半字节相差 8 的字节会共用一位，由 isCandidate 精确排除。
+    static constexpr std::array<uint8_t, 16> kHighNibbles{{1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128}};
+    std::array<uint8_t, 16> lowNibbles{};
+    std::array<uint64_t, 4> firstBytes{};
+    std::array<uint64_t, 4> singleBytes{};
+    std::vector<uint64_t> bigrams;
+
+    void addFirstByte(unsigned char c) {
+        setBit(firstBytes.data(), c);
+        addNibble(lowNibbles, c);
+    }
+
+    static size_t bigramIndex(unsigned char first, unsigned char second) {
+        return (static_cast<size_t>(first) << 8) | second;
+    }
+
+    static void setBit(uint64_t* bits, size_t index) {
+        bits[index >> 6] |= uint64_t(1) << (index & 63);
+    }
+
+    static bool testBit(const uint64_t* bits, size_t index) {
+        return (bits[index >> 6] >> (index & 63)) & 1;
+    }
+};
+
+/**
+ * @brief 解析后的正则表达式集合，供 CompiledRegexSet 编译为自动机
+ *
+ * 支持 ECMAScript 语法的常用子集：字面字符、转义（\d \w \s 及其大写形式、\t \n \xHH 等）、
+ * '.'、字符类 [...] / [^...]、分组 ( ) / (?: )、'|'，以及量词 * + ? {n} {n,} {n,m}。
+ * 锚点、单词边界、反向引用、环视等语法不在此列，由调用方退回 std::regex。
+ * 所有模式按忽略大小写处理。
+ */
+class RegexPatternSet {
+public:
+    using ByteSet = std::bitset<256>;
+
+    /**
+     * @brief 解析并添加一个模式
+     * @param pattern 正则表达式
+     * @param id 模式编号
+     * @return false 如果模式使用了不支持的语法或无法解析
+     */
+    bool add(const std::string& pattern, uint32_t id) {
+        size_t mark = nodes.size();
+        Parser parser(pattern, nodes);
+        int32_t root = parser.parse();
+        if (root < 0) {
+            nodes.resize(mark);
+            return false;
+        }
+        patterns.push_back({root, id, pattern});
+        return true;
+    }
+
+    bool empty() const {
+        return patterns.empty();
+    }
+
+    /**
+     * @brief 已添加的 (编号, 模式) 列表
+     */
+    std::vector<std::pair<uint32_t, std::string>> sources() const {
+        std::vector<std::pair<uint32_t, std::string>> result;
+        for (const auto& pattern : patterns) {
+            result.emplace_back(pattern.id, pattern.source);
+        }
+        return result;
+    }
+
+private:
+    friend class CompiledRegexSet;
+
+    static constexpr int kUnbounded = -1;
+    static constexpr int kMaxRepeat = 64; // 更大的计数重复会让自动机过大，交给 std::regex
+
+    enum class NodeKind { Empty, Set, Concat, Alternate, Repeat };
+
+    struct Node {
+        NodeKind kind = NodeKind::Empty;
+        ByteSet set;
+        std::vector<int32_t> children;
+        int min = 0;
+        int max = 0;
+    };
+
+    struct Pattern {
+        int32_t root;
+        uint32_t id;
+        std::string source;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Pattern> patterns;
+
+    /**
+     * @brief 递归下降解析器，遇到不支持的语法时返回 -1
+     */
+    class Parser {
+    public:
+        Parser(std::string_view pattern, std::vector<Node>& nodes) : pattern(pattern), nodes(nodes) {}
+
+        int32_t parse() {
+            int32_t root = parseAlternation();
+            if (!ok || pos != pattern.size()) {
+                return -1;
+            }
+            return root;
+        }
+
+    private:
+        std::string_view pattern;
+        std::vector<Node>& nodes;
+        size_t pos = 0;
+        bool ok = true;
+
+        bool atEnd() const {
+            return pos >= pattern.size();
+        }
+
+        char peek() const {
+            return pattern[pos];
+        }
+
+        int32_t fail() {
+            ok = false;
+            return -1;
+        }
+
+        int32_t addNode(Node node) {
+            nodes.push_back(std::move(node));
+            return static_cast<int32_t>(nodes.size() - 1);
+        }
+
+        int32_t addSet(ByteSet set) {
+            // 忽略大小写：字母的两种大小写同时加入
+            for (int c = 'a'; c <= 'z'; ++c) {
+                if (set.test(c) || set.test(c - ('a' - 'A'))) {
+                    set.set(c);
+                    set.set(c - ('a' - 'A'));
+                }
+            }
+            Node node;
+            node.kind = NodeKind::Set;
+            node.set = set;
+            return addNode(std::move(node));
+        }
+
+        int32_t parseAlternation() {
+            std::vector<int32_t> branches = {parseConcat()};
+            while (ok && !atEnd() && peek() == '|') {
+                ++pos;
+                branches.push_back(parseConcat());
+            }
+            if (!ok) {
+                return -1;
+            }
+            if (branches.size() == 1) {
+                return branches.front();
+            }
+            Node node;
+            node.kind = NodeKind::Alternate;
+            node.children = std::move(branches);
+            return addNode(std::move(node));
+        }
+
+        int32_t parseConcat() {
+            Node node;
+            node.kind = NodeKind::Concat;
+            while (ok && !atEnd() && peek() != '|' && peek() != ')') {
+                node.children.push_back(parseRepeat());
+            }
+            if (!ok) {
+                return -1;
+            }
+            if (node.children.size() == 1) {
+                return node.children.front();
+            }
+            if (node.children.empty()) {
+                node.kind = NodeKind::Empty;
+            }
+            return addNode(std::move(node));
+        }
+
+        int32_t parseRepeat() {
+            int32_t atom = parseAtom();
+            while (ok && !atEnd()) {
+                int min = 0;
+                int max = 0;
+                char c = peek();
+                if (c == '*') {
+                    min = 0;
+                    max = kUnbounded;
+                    ++pos;
+                } else if (c == '+') {
+                    min = 1;
+                    max = kUnbounded;
+                    ++pos;
+                } else if (c == '?') {
+                    min = 0;
+                    max = 1;
+                    ++pos;
+                } else if (c == '{') {
+                    if (!parseBounds(min, max)) {
+                        return fail();
+                    }
+                } else {
+                    break;
+                }
+                // 非贪婪后缀不影响匹配到的区间集合
+                if (!atEnd() && peek() == '?') {
+                    ++pos;
+                }
+
+                Node node;
+                node.kind = NodeKind::Repeat;
+                node.children = {atom};
+                node.min = min;
+                node.max = max;
+                atom = addNode(std::move(node));
+            }
+            return atom;
+        }
+
+        bool parseBounds(int& min, int& max) {
+            ++pos; // '{'
+            if (!parseNumber(min)) {
+                return false;
+            }
+            max = min;
+            if (!atEnd() && peek() == ',') {
+                ++pos;
+                max = kUnbounded;
+                if (!atEnd() && peek() != '}' && !parseNumber(max)) {
+                    return false;
+                }
+            }
+            if (atEnd() || peek() != '}') {
+                return false;
+            }
+            ++pos;
+            return (max == kUnbounded || max >= min) && min <= kMaxRepeat && max <= kMaxRepeat;
+        }
+
+        bool parseNumber(int& value) {
+            size_t start = pos;
+            value = 0;
+            while (!atEnd() && peek() >= '0' && peek() <= '9' && value <= kMaxRepeat) {
+                value = value * 10 + (peek() - '0');
+                ++pos;
+            }
+            return pos > start;
+        }
+
+        int32_t parseAtom() {
+            if (atEnd()) {
+                return fail();
+            }
+
+            char c = pattern[pos++];
+            ByteSet set;
+            switch (c) {
+                case '(': {
+                    if (!atEnd() && peek() == '?') {
+                        if (pos + 1 < pattern.size() && pattern[pos + 1] == ':') {
+                            pos += 2;
+                        } else {
+                            return fail(); // 环视等扩展语法
+                        }
+                    }
+                    int32_t inner = parseAlternation();
+                    if (!ok || atEnd() || peek() != ')') {
+                        return fail();
+                    }
+                    ++pos;
+                    return inner;
+                }
+                case '[':
+                    if (!parseClass(set)) {
+                        return fail();
+                    }
+                    return addSet(set);
+                case '.':
+                    set.set();
+                    set.reset('\n');
+                    set.reset('\r');
+                    return addSet(set);
+                case '\\':
+                    if (!parseEscape(set, false)) {
+                        return fail();
+                    }
+                    return addSet(set);
+                case '^':
+                case '$':
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                case '}':
+                case ')':
+                case '|':
+                    return fail();
+                default:
+                    set.set(static_cast<unsigned char>(c));
+                    return addSet(set);
+            }
+        }
+
+        bool parseClass(ByteSet& set) {
+            bool negate = false;
+            if (!atEnd() && peek() == '^') {
+                negate = true;
+                ++pos;
+            }
+
+            bool first = true;
+            while (!atEnd() && (peek() != ']' || first)) {
+                first = false;
+                int low = -1;
+                if (!parseClassAtom(set, low)) {
+                    return false;
+                }
+
+                // 区间 a-z；'-' 出现在末尾时按字面处理
+                if (low >= 0 && pos + 1 < pattern.size() && peek() == '-' && pattern[pos + 1] != ']') {
+                    ++pos;
+                    int high = -1;
+                    ByteSet ignored;
+                    if (!parseClassAtom(ignored, high) || high < low) {
+                        return false;
+                    }
+                    for (int b = low; b <= high; ++b) {
+                        set.set(b);
+                    }
+                }
+            }
+            if (atEnd()) {
+                return false;
+            }
+            ++pos; // ']'
+
+            if (negate) {
+                // 忽略大小写的取反：先补全大小写再取反
+                for (int ch = 'a'; ch <= 'z'; ++ch) {
+                    if (set.test(ch) || set.test(ch - ('a' - 'A'))) {
+                        set.set(ch);
+                        set.set(ch - ('a' - 'A'));
+                    }
+                }
+                set.flip();
+            }
+            return true;
+        }
+
+        /**
+         * @brief 解析字符类中的一项；单个字符时通过 literal 返回其值，否则为 -1
+         */
+        bool parseClassAtom(ByteSet& set, int& literal) {
+            char c = pattern[pos++];
+            if (c != '\\') {
+                literal = static_cast<unsigned char>(c);
+                set.set(literal);
+                return true;
+            }
+            ByteSet escaped;
+            if (!parseEscape(escaped, true)) {
+                return false;
+            }
+            if (escaped.count() == 1) {
+                for (int b = 0; b < 256; ++b) {
+                    if (escaped.test(b)) {
+                        literal = b;
+                    }
+                }
+            }
+            set |= escaped;
+            return true;
+        }
+
+        bool parseEscape(ByteSet& set, bool inClass) {
+            if (atEnd()) {
+                return false;
+            }
+            char c = pattern[pos++];
+            switch (c) {
+                case 'd':
+                    addRange(set, '0', '9');
+                    return true;
+                case 'D':
+                    addRange(set, '0', '9');
+                    set.flip();
+                    return true;
+                case 'w':
+                    addWordChars(set);
+                    return true;
+                case 'W':
+                    addWordChars(set);
+                    set.flip();
+                    return true;
+                case 's':
+                    addSpaces(set);
+                    return true;
+                case 'S':
+                    addSpaces(set);
+                    set.flip();
+                    return true;
+                case 't':
+                    set.set('\t');
+                    return true;
+                case 'n':
+                    set.set('\n');
+                    return true;
+                case 'r':
+                    set.set('\r');
+                    return true;
+                case 'f':
+                    set.set('\f');
+                    return true;
+                case 'v':
+                    set.set('\v');
+                    return true;
+                case '0':
+                    set.set(0);
+                    return true;
+                case 'x': {
+                    if (pos + 2 > pattern.size()) {
+                        return false;
+                    }
+                    int high = hexValue(pattern[pos]);
+                    int low = hexValue(pattern[pos + 1]);
+                    if (high < 0 || low < 0) {
+                        return false;
+                    }
+                    pos += 2;
+                    set.set(high * 16 + low);
+                    return true;
+                }
+                case 'b':
+                    // 字符类中的 \b 是退格，其他位置是单词边界（不支持）
+                    if (inClass) {
+                        set.set('\b');
+                        return true;
+                    }
+                    return false;
+                default:
+                    // 其余字母、数字转义（\B、\1、\u、\c 等）交给 std::regex
+                    if (std::isalnum(static_cast<unsigned char>(c))) {
+                        return false;
+                    }
+                    set.set(static_cast<unsigned char>(c));
+                    return true;
+            }
+        }
+
+        static int hexValue(char c) {
+            if (c >= '0' && c <= '9') {
+                return c - '0';
+            }
+            if (c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            if (c >= 'A' && c <= 'F') {
+                return c - 'A' + 10;
+            }
+            return -1;
+        }
+
+        static void addRange(ByteSet& set, int low, int high) {
+            for (int b = low; b <= high; ++b) {
+                set.set(b);
+            }
+        }
+
+        static void addWordChars(ByteSet& set) {
+            addRange(set, 'a', 'z');
+            addRange(set, 'A', 'Z');
+            addRange(set, '0', '9');
+            set.set('_');
+        }
+
+        static void addSpaces(ByteSet& set) {
+            for (char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+                set.set(static_cast<unsigned char>(c));
+            }
+        }
+    };
+};
+
+/**
+ * @brief 编译后的多模式正则自动机
+ *
+ * 所有模式合并为一个 Thompson NFA，再用子集构造一次性生成两个 DFA：
+ * - 正向 DFA：在每个位置隐式加入所有模式的起点（非锚定搜索），一次扫描找出所有
+ *   “有匹配在此结束”的位置，同时按模式编号记录接受状态；
+ * - 反向 DFA：由反转后的模式构建，从匹配结束位置向左扫描，找出起点；向左最多扫描到上一个
+ *   匹配的结束位置，每个字节至多被反向扫描一次，总耗时与正文长度成线性关系。
+ * 字节先映射到等价类再查表，表的大小为 状态数 × 等价类数。
+ * DFA 在编译时完整生成，扫描期间只读，可以被多个线程同时使用。
+ * 无论加载了多少模式，正文都只正向扫描一次。
+ *
+ * 匹配语义与 std::regex 不同：所有模式作为一个整体，按结束位置从左到右给出互不重叠的区间
+ * （见 scan），与前一个区间重叠的匹配并入前一个区间，不区分分支的先后顺序。例如 "b|ba" 屏蔽
+ * "Bac" 得到 "**c"，"(?:bb)+" 屏蔽 "abbbc" 得到 "a***c"，"[ab][bc]" 屏蔽 "cabcb" 得到 "c***b"；
+ * 逐个模式调用 std::regex_search（最左、按分支顺序、互不重叠）得到的分别是 "*ac"、"a**bc"、"c**cb"。
+ * RegexFilter 中无法编译进自动机的模式仍然使用 std::regex 的语义。
+ */
+class CompiledRegexSet {
+public:
+    static constexpr uint32_t kNoPattern = 0xffffffffu;
+
+    /**
+     * @brief 编译模式集合
+     * @return 状态数超过上限时返回 valid() == false 的对象
+     */
+    static CompiledRegexSet compile(const RegexPatternSet& patterns) {
+        CompiledRegexSet result;
+        if (patterns.empty()) {
+            return result;
+        }
+
+        Nfa forward(patterns, false);
+        Nfa reverse(patterns, true);
+        if (forward.overflow || reverse.overflow) {
+            result.isValid = false;
+            return result;
+        }
+        result.buildByteClasses(forward);
+        result.patternCount = patterns.patterns.size();
+        result.isValid = result.forwardDfa.build(forward, result, true) &&
+                         result.reverseDfa.build(reverse, result, false);
+        if (result.isValid) {
+            result.buildStartSkip();
+        }
+        return result;
+    }
+
+    bool valid() const {
+        return isValid;
+    }
+
+    bool empty() const {
+        return patternCount == 0;
+    }
+
+    /**
+     * @brief 是否存在任意模式的非空匹配，遇到第一个匹配即返回
+     */
+    bool containsMatch(std::string_view text) const {
+        if (empty()) {
+            return false;
+        }
+
+        int32_t state = forwardDfa.start;
+        for (size_t j = 0; j < text.length(); ++j) {
+            if (state == forwardDfa.start) {
+                j = startBytes.nextCandidate(text.data(), text.length(), j);
+                if (j == text.length()) {
+                    break;
+                }
+            }
+            state = forwardDfa.next(state, byteClass[static_cast<unsigned char>(text[j])]);
+            if (forwardDfa.accept[state] != kNoPattern) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 按从左到右的顺序输出互不重叠的匹配区间
+     *
+     * 对每个有匹配结束的位置 j（从小到大）：若以 j 结尾的匹配可以从上一个区间的结束位置之后开始，
+     * 取其中最靠左的起点作为新的区间；否则该匹配与上一个区间重叠，上一个区间延长到 j。
+     * 因此 "fu+ck+" 在 "fuuckkk" 中只给出一个覆盖全部字节的区间。
+     * @param emit 回调 emit(start, length, patternId)
+     */
+    template <typename Emit>
+    void scan(std::string_view text, Emit&& emit) const {
+        if (empty()) {
+            return;
+        }
+
+        bool pending = false;
+        size_t pendingStart = 0;
+        size_t pendingEnd = 0; // 反向扫描不越过该位置，没有待定区间时为 0
+        uint32_t pendingPattern = kNoPattern;
+
+        int32_t state = forwardDfa.start;
+        for (size_t j = 0; j < text.length(); ++j) {
+            if (state == forwardDfa.start) {
+                // 初始状态下不能开始任何模式的字节不改变状态，整段跳过
+                j = startBytes.nextCandidate(text.data(), text.length(), j);
+                if (j == text.length()) {
+                    break;
+                }
+            }
+            state = forwardDfa.next(state, byteClass[static_cast<unsigned char>(text[j])]);
+            if (forwardDfa.accept[state] == kNoPattern) {
+                continue;
+            }
+
+            // 从 j 向左、在上一个区间之后找最靠左的起点
+            int32_t reverseState = reverseDfa.start;
+            size_t start = std::string_view::npos;
+            uint32_t pattern = kNoPattern;
+            for (size_t p = j + 1; p-- > pendingEnd;) {
+                reverseState = reverseDfa.next(reverseState, byteClass[static_cast<unsigned char>(text[p])]);
+                if (reverseState == kDeadState) {
+                    break;
+                }
+                if (reverseDfa.accept[reverseState] != kNoPattern) {
+                    start = p;
+                    pattern = reverseDfa.accept[reverseState];
+                }
+            }
+            if (start == std::string_view::npos) {
+                // 以 j 结尾的匹配都从上一个区间之内开始（正向 DFA 已确认匹配存在），合并到上一个区间
+                if (pending) {
+                    pendingEnd = j + 1;
+                }
+                continue;
+            }
+
+            if (pending) {
+                emit(pendingStart, pendingEnd - pendingStart, pendingPattern);
+            }
+            pending = true;
+            pendingStart = start;
+            pendingEnd = j + 1;
+            pendingPattern = pattern;
+        }
+        if (pending) {
+            emit(pendingStart, pendingEnd - pendingStart, pendingPattern);
+        }
+    }
+
+    size_t stateCount() const {
+        return forwardDfa.accept.size() + reverseDfa.accept.size();
+    }
+
+private:
+    static constexpr int32_t kDeadState = 0;
+    static constexpr size_t kMaxTableEntries = size_t(1) << 22; // 每个 DFA 最多约 16 MB
+    static constexpr size_t kMaxNfaStates = size_t(1) << 20;
+
+    using ByteSet = RegexPatternSet::ByteSet;
+
+    /**
+     * @brief Thompson NFA：Byte 状态消耗一个字节，Split 为空转移，Accept 标记模式结束
+     */
+    struct Nfa {
+        enum class Kind : uint8_t { Byte, Split, Accept };
+
+        struct State {
+            Kind kind;
+            int32_t set;  // Byte: 字节集合下标
+            int32_t out;  // 后继状态
+            int32_t out1; // Split 的第二个后继，没有时为 -1
+            uint32_t pattern;
+        };
+
+        std::vector<State> states;
+        std::vector<ByteSet> sets;
+        std::vector<int32_t> starts;
+        bool overflow = false;
+
+        Nfa(const RegexPatternSet& patterns, bool reversed) {
+            for (const auto& pattern : patterns.patterns) {
+                int32_t accept = addState({Kind::Accept, -1, -1, -1, pattern.id});
+                starts.push_back(compileNode(patterns.nodes, pattern.root, accept, reversed));
+            }
+        }
+
+        int32_t addState(State state) {
+            if (states.size() >= kMaxNfaStates) {
+                overflow = true;
+                return 0;
+            }
+            states.push_back(state);
+            return static_cast<int32_t>(states.size() - 1);
+        }
+
+        int32_t addSplit(int32_t out, int32_t out1) {
+            return addState({Kind::Split, -1, out, out1, kNoPattern});
+        }
+
+        /**
+         * @brief 从后往前构造：返回匹配 node 后继续到 next 的起始状态
+         */
+        int32_t compileNode(const std::vector<RegexPatternSet::Node>& nodes, int32_t index,
+                            int32_t next, bool reversed) {
+            const auto& node = nodes[index];
+            switch (node.kind) {
+                case RegexPatternSet::NodeKind::Empty:
+                    return next;
+                case RegexPatternSet::NodeKind::Set:
+                    sets.push_back(node.set);
+                    return addState({Kind::Byte, static_cast<int32_t>(sets.size() - 1), next, -1, kNoPattern});
+                case RegexPatternSet::NodeKind::Concat:
+                    if (reversed) {
+                        for (int32_t child : node.children) {
+                            next = compileNode(nodes, child, next, reversed);
+                        }
+                    } else {
+                        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                            next = compileNode(nodes, *it, next, reversed);
+                        }
+                    }
+                    return next;
+                case RegexPatternSet::NodeKind::Alternate: {
+                    int32_t result = compileNode(nodes, node.children.back(), next, reversed);
+                    for (size_t i = node.children.size() - 1; i-- > 0;) {
+                        int32_t branch = compileNode(nodes, node.children[i], next, reversed);
+                        result = addSplit(branch, result);
+                    }
+                    return result;
+                }
+                case RegexPatternSet::NodeKind::Repeat: {
+                    int32_t child = node.children.front();
+                    int32_t result = next;
+                    if (node.max == RegexPatternSet::kUnbounded) {
+                        int32_t loop = addSplit(-1, next);
+                        int32_t body = compileNode(nodes, child, loop, reversed);
+                        states[loop].out = body;
+                        result = loop;
+                    } else {
+                        for (int i = node.min; i < node.max; ++i) {
+                            int32_t body = compileNode(nodes, child, result, reversed);
+                            result = addSplit(body, next);
+                        }
+                    }
+                    for (int i = 0; i < node.min; ++i) {
+                        result = compileNode(nodes, child, result, reversed);
+                    }
+                    return result;
+                }
+            }
+            return next;
+        }
+
+        /**
+         * @brief 空转移闭包，结果只保留 Byte 和 Accept 状态，按下标排序
+         */
+        void closure(std::vector<int32_t>& stack, std::vector<int32_t>& result,
+                     std::vector<uint32_t>& visited, uint32_t mark) const {
+            result.clear();
+            while (!stack.empty()) {
+                int32_t s = stack.back();
+                stack.pop_back();
+                if (s < 0 || visited[s] == mark) {
+                    continue;
+                }
+                visited[s] = mark;
+                const State& state = states[s];
+                if (state.kind == Kind::Split) {
+                    stack.push_back(state.out1);
+                    stack.push_back(state.out);
+                } else {
+                    result.push_back(s);
+                }
+            }
+            std::sort(result.begin(), result.end());
+        }
+    };
+
+    /**
+     * @brief 字节等价类上的 DFA 转移表
+     */
+    struct Dfa {
+        std::vector<int32_t> transitions; // 状态 × 等价类
+        std::vector<uint32_t> accept;     // 消耗字节后到达该状态时完成匹配的最小模式编号
+        int32_t start = 0;
+        size_t classes = 1;
+
+        int32_t next(int32_t state, uint8_t byteClass) const {
+            return transitions[static_cast<size_t>(state) * classes + byteClass];
+        }
+
+        /**
+         * @brief 子集构造
+         * @param unanchored 为 true 时每一步都重新加入所有模式的起点
+         */
+        bool build(const Nfa& nfa, const CompiledRegexSet& owner, bool unanchored) {
+            classes = owner.classCount;
+            std::map<std::vector<int32_t>, int32_t> ids;
+            std::vector<std::vector<int32_t>> pending;
+            std::vector<uint32_t> visited(nfa.states.size(), 0);
+            uint32_t mark = 0;
+            std::vector<int32_t> stack;
+            std::vector<int32_t> closure;
+
+            auto intern = [&](const std::vector<int32_t>& set) {
+                auto it = ids.find(set);
+                if (it != ids.end()) {
+                    return it->second;
+                }
+                int32_t id = static_cast<int32_t>(pending.size());
+                ids.emplace(set, id);
+                pending.push_back(set);
+                uint32_t best = kNoPattern;
+                for (int32_t s : set) {
+                    if (nfa.states[s].kind == Nfa::Kind::Accept) {
+                        best = std::min(best, nfa.states[s].pattern);
+                    }
+                }
+                accept.push_back(best);
+                return id;
+            };
+
+            // 反向 DFA 的 0 号状态是空集（死状态）；正向 DFA 的空集就是初始状态
+            intern({});
+            std::vector<int32_t> startSet;
+            stack = nfa.starts;
+            nfa.closure(stack, startSet, visited, ++mark);
+            // 接受状态只在消耗字节之后检查，因此空匹配不会被报告
+            start = unanchored ? 0 : intern(startSet);
+
+            for (size_t id = 0; id < pending.size(); ++id) {
+                if (pending.size() * classes > kMaxTableEntries) {
+                    return false;
+                }
+                transitions.resize(pending.size() * classes, kDeadState);
+                for (size_t cls = 0; cls < classes; ++cls) {
+                    unsigned char byte = owner.classRepresentative[cls];
+                    ++mark;
+                    auto moveFrom = [&](const std::vector<int32_t>& from) {
+                        for (int32_t s : from) {
+                            const auto& state = nfa.states[s];
+                            if (state.kind == Nfa::Kind::Byte && nfa.sets[state.set].test(byte)) {
+                                stack.push_back(state.out);
+                            }
+                        }
+                    };
+                    moveFrom(pending[id]);
+                    if (unanchored) {
+                        moveFrom(startSet);
+                    }
+                    nfa.closure(stack, closure, visited, mark);
+                    int32_t target = intern(closure);
+                    transitions[id * classes + cls] = target;
+                }
+            }
+            transitions.resize(pending.size() * classes, kDeadState);
+            return true;
+        }
+    };
+
+    std::array<uint8_t, 256> byteClass{};
+    std::vector<unsigned char> classRepresentative = {0};
+    size_t classCount = 1;
+    size_t patternCount = 0;
+    bool isValid = true;
+    Dfa forwardDfa;
+    Dfa reverseDfa;
+    FirstBytePrefilter startBytes; // 使正向 DFA 离开初始状态的字节
+
+    /**
+     * @brief 非锚定搜索的初始状态在读到不能开始任何模式的字节时保持不变，
+     *        把其余字节交给 FirstBytePrefilter，扫描时用向量指令跳过
+     */
+    void buildStartSkip() {
+        for (int c = 0; c < 256; ++c) {
+            auto byte = static_cast<unsigned char>(c);
+            if (forwardDfa.next(forwardDfa.start, byteClass[byte]) != forwardDfa.start) {
+                char word = static_cast<char>(foldCase(byte));
+                startBytes.addWord(std::string_view(&word, 1));
+            }
+        }
+    }
+
+    /**
+     * @brief 按 NFA 中出现的所有字节集合细分等价类
+     */
+    void buildByteClasses(const Nfa& nfa) {
+        std::array<int, 256> classes{};
+        int count = 1;
+        for (const auto& set : nfa.sets) {
+            std::map<std::pair<int, bool>, int> split;
+            int next = 0;
+            for (int b = 0; b < 256; ++b) {
+                auto key = std::make_pair(classes[b], set.test(b));
+                auto it = split.find(key);
+                if (it == split.end()) {
+                    it = split.emplace(key, next++).first;
+                }
+                classes[b] = it->second;
+            }
+            count = next;
+        }
+
+        classCount = static_cast<size_t>(count);
+        classRepresentative.assign(classCount, 0);
+        std::vector<bool> seen(classCount, false);
+        for (int b = 0; b < 256; ++b) {
+            byteClass[b] = static_cast<uint8_t>(classes[b]);
+            if (!seen[classes[b]]) {
+                seen[classes[b]] = true;
+                classRepresentative[classes[b]] = static_cast<unsigned char>(b);
+            }
+        }
+    }
+};
+
+/**
+ * @brief 正则表达式法 - 使用正则表达式匹配脏话
+ * 
+ * 优点：可以处理复杂的模式匹配，支持变体
+ * 缺点：正则表达式可能较难维护，性能中等
+ */
+class RegexFilter : public ProfanityFilter {
+private:
+    /**
+     * @brief 由 std::regex 匹配的模式；boundaryBefore 为 true 时匹配的起点之前必须是单词边界
+     *
+     * std::regex 的 \b 把非 ASCII 字节当作非单词字符，与 isWordByte 不一致，也不支持后行断言，
+     * 因此起点的边界在找到匹配后用 isWordByte 检查，结尾的边界用 kWordEnd 前瞻实现。
+     */
+    struct StdPattern {
+        uint32_t id;
+        std::regex regex;
+        bool boundaryBefore;
+    };
+
+    // 与 isWordByte 相同的单词字符：字母、数字、_ 和所有非 ASCII 字节
+    static constexpr const char* kWordEnd = "(?![0-9A-Za-z_]|[^\\x00-\\x7f])";
+
+    // 可以编译进自动机的模式；使用了不支持的语法的模式单独保存为 std::regex
+    RegexPatternSet patternSet;
+    std::vector<StdPattern> profanityPatterns;
+    uint32_t patternCount = 0;
+    char replacementChar;
+
+    // 首次查询时由 patternSet 编译生成；自动机超出大小上限时，所有模式改用 std::regex
+    mutable CompiledRegexSet compiled;
+    mutable std::vector<StdPattern> oversizedPatterns;
+    mutable std::atomic<bool> compiledReady{false};
+    mutable std::mutex compileMutex;
+    std::vector<std::string> allowedPhrases; // 已转为小写
+    
+public:
+    /**
+     * @param defaultPatterns 为 false 时不加载默认模式，由调用方（如 HybridFilter）决定词表
+     */
+    explicit RegexFilter(char replacementChar = '*', bool defaultPatterns = true) 
+        : replacementChar(replacementChar) {
+        if (!defaultPatterns) {
+            return;
+        }
+        // 默认正则表达式模式（支持一些变体）
+        addPattern("shit");
+        addPattern("fuck");
+        addPattern("damn");
+        addPattern("ass");
+        addPattern("bitch");
+        addPattern("bastard");
+        addVariantPatterns();
+    }
+
+    /**
+     * @brief 添加默认的变体模式，如 f*ck, f**k, sh*t 等；不含普通词，供与其他引擎组合时使用
+     */
+    void addVariantPatterns() {
+        addPattern("f[aeiou*]+ck");
+        addPattern("sh[aeiou*]+t");
+    }
+    
+    using ProfanityFilter::containsProfanity;
+    
+    // 所有模式都忽略大小写，直接在原文上匹配，无需小写副本
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        ensureCompiled();
+        if (!allowedPhrases.empty()) {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            findMatches(text, matches);
+            return !matches.empty();
+        }
+        if (compiled.containsMatch(text)) {
+            return true;
+        }
+
+        bool found = false;
+        forEachRegex([&](const StdPattern& pattern) {
+            searchAll(text, pattern, [&](size_t, size_t) {
+                found = true;
+                return false;
+            });
+            return !found;
+        });
+        return found;
+    }
+    
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        // 先在原文上找出所有位置再统一替换，避免已替换的字符影响后续模式的匹配
+        ScratchMatches scratch;
+        std::vector<Match>& matches = scratch.get();
+        findMatches(std::string_view(buf, len), matches);
+        applyMatches(buf, len, matches, replacementChar);
+    }
+    
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        ensureCompiled();
+        size_t first = matches.size();
+        compiled.scan(text, [&](size_t start, size_t length, uint32_t patternId) {
+            matches.push_back({start, length, patternId});
+        });
+
+        forEachRegex([&](const StdPattern& pattern) {
+            searchAll(text, pattern, [&](size_t pos, size_t length) {
+                matches.push_back({pos, length, pattern.id});
+                return true;
+            });
+            return true;
+        });
+        removeAllowed(text, matches, first, allowedPhrases);
+        scope.matches(matches.data() + first, matches.data() + matches.size());
+    }
+    
+    void addProfanity(const std::string& word) override {
+        addPattern(word);
+    }
+
+    /**
+     * @brief 有边界要求的模式由 std::regex 匹配，单词字符与 isWordByte 相同（见 StdPattern）
+     */
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        switch (boundary) {
+        case BoundaryMode::Substring:
+            addPattern(word);
+            break;
+        case BoundaryMode::Prefix:
+            addStdPattern("(?:" + word + ")", true);
+            break;
+        case BoundaryMode::WholeWord:
+            addStdPattern("(?:" + word + ")" + kWordEnd, true);
+            break;
+        }
+    }
+
+    /**
+     * @brief 白名单短语按字面匹配，命中后只在其附近查找
+     */
+    void addAllowedPhrase(const std::string& phrase) override {
+        if (!phrase.empty()) {
+            std::string lower = phrase;
+            for (char& c : lower) {
+                c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+            }
+            allowedPhrases.push_back(std::move(lower));
+        }
+    }
+
+    void compile() override {
+        ensureCompiled();
+    }
+
+    bool hasPatterns() const {
+        return patternCount > 0;
+    }
+    
+    void loadFromFile(const std::string& filename) override {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return;
+        }
+        
+        std::string word;
+        while (std::getline(file, word)) {
+            if (!word.empty()) {
+                addPattern(word);
+            }
+        }
+        file.close();
+    }
+    
+private:
+    void addPattern(const std::string& pattern) {
+#ifndef PROFANITY_FILTER_STD_REGEX
+        if (patternSet.add(pattern, patternCount)) {
+            ++patternCount;
+            compiledReady.store(false, std::memory_order_release);
+            return;
+        }
+#endif
+        addStdPattern(pattern, false);
+    }
+
+    void addStdPattern(const std::string& pattern, bool boundaryBefore) {
+        try {
+            profanityPatterns.push_back({patternCount, std::regex(pattern, std::regex::icase), boundaryBefore});
+            ++patternCount;
+        } catch (const std::regex_error& e) {
+            std::cerr << "正则表达式错误: " << e.what() << " - 模式: " << pattern << std::endl;
+        }
+    }
+
+    void ensureCompiled() const {
+        if (compiledReady.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(compileMutex);
+        if (compiledReady.load(std::memory_order_relaxed)) {
+            return;
+        }
+        compiled = CompiledRegexSet::compile(patternSet);
+        oversizedPatterns.clear();
+        if (!compiled.valid()) {
+            std::cerr << "正则表达式自动机过大，改用 std::regex 逐个匹配" << std::endl;
+            compiled = CompiledRegexSet();
+            for (const auto& source : patternSet.sources()) {
+                oversizedPatterns.push_back({source.first, std::regex(source.second, std::regex::icase), false});
+            }
+        }
+        compiledReady.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief 依次访问所有需要用 std::regex 匹配的模式，visit 返回 false 时停止
+     */
+    template <typename Visit>
+    void forEachRegex(Visit&& visit) const {
+        for (const StdPattern& pattern : profanityPatterns) {
+            if (!visit(pattern)) {
+                return;
+            }
+        }
+        for (const StdPattern& pattern : oversizedPatterns) {
+            if (!visit(pattern)) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief 依次找出 pattern 互不重叠的非空匹配，对每个匹配调用 emit(pos, length)，emit 返回 false 时停止
+     *
+     * 从中间继续查找时传入 match_prev_avail，前瞻和 \b 能看到继续位置之前的字节。
+     * 起点之前不是单词边界的匹配被丢弃，从下一个字节重新查找。
+     */
+    template <typename Emit>
+    static void searchAll(std::string_view text, const StdPattern& pattern, Emit&& emit) {
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        std::cmatch match;
+        const char* searchStart = begin;
+
+        while (searchStart != end || searchStart == begin) {
+            auto flags = searchStart != begin ? std::regex_constants::match_prev_avail
+                                              : std::regex_constants::match_default;
+            if (!std::regex_search(searchStart, end, match, pattern.regex, flags)) {
+                break;
+            }
+            size_t pos = match.position() + (searchStart - begin);
+            size_t length = match.length();
+            if (length > 0 && pattern.boundaryBefore && pos > 0 &&
+                isWordByte(static_cast<unsigned char>(text[pos - 1]))) {
+                searchStart = begin + pos + 1;
+                continue;
+            }
+            if (length > 0 && !emit(pos, length)) {
+                return;
+            }
+
+            searchStart = match.suffix().first;
+            if (length == 0) {
+                if (searchStart == end) {
+                    break;
+                }
+                ++searchStart;
+            }
+        }
+    }
+};
+
+/**
+ * @brief 字典树节点，用于高效存储和查找脏话
+ *
+ * 节点及其子节点表都分配在所属 TrieArena 的内存中，由 TrieArena 统一释放。
+ */
+class TrieNode {
+public:
+    std::pmr::unordered_map<char, TrieNode*> children;
+    bool isEndOfWord;
+    uint32_t patternId; // 词尾节点对应的脏话编号
+    BoundaryMode boundary; // 词尾节点对应的脏话的边界要求
+    bool isAllowed;        // 词尾节点是白名单短语而不是脏话
+    
+    explicit TrieNode(std::pmr::memory_resource* resource)
+        : children(resource), isEndOfWord(false), patternId(0), boundary(BoundaryMode::Substring),
+          isAllowed(false) {}
+};
+
+/**
+ * @brief 可变字典树的内存区域 - 所有节点从一块单调增长的缓冲区中分配
+ *
+ * 添加节点只是移动指针，内存按块向 upstream 申请，块大小成倍增长；
+ * 销毁整棵树时一次性归还所有块，不逐个析构节点。
+ * 每个区域只被一个线程修改，多个过滤器同时重建时不会争用全局分配器。
+ */
+class TrieArena {
+public:
+    /**
+     * @param upstream 申请内存块的来源，默认使用 new/delete
+     */
+    explicit TrieArena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : resource(kInitialBlockSize, upstream), rootNode(newNode()) {}
+
+    TrieArena(const TrieArena&) = delete;
+    TrieArena& operator=(const TrieArena&) = delete;
+
+    TrieNode* root() {
+        return rootNode;
+    }
+
+    const TrieNode* root() const {
+        return rootNode;
+    }
+
+    /**
+     * @brief 在区域中创建一个空节点，节点随区域一起释放
+     */
+    TrieNode* newNode() {
+        void* memory = resource.allocate(sizeof(TrieNode), alignof(TrieNode));
+        ++nodes;
+        return new (memory) TrieNode(&resource);
+    }
+
+    size_t nodeCount() const {
+        return nodes;
+    }
+
+    std::pmr::memory_resource* upstream() const {
+        return resource.upstream_resource();
+    }
+
+private:
+    static constexpr size_t kInitialBlockSize = 64 * 1024;
+
+    std::pmr::monotonic_buffer_resource resource;
+    size_t nodes = 0;
+    TrieNode* rootNode;
+};
+
+/**
+ * @brief 编译后的字典树 - 双数组（double-array）布局，附带 Aho-Corasick 失败指针
+ *
+ * 由可变的 TrieNode 树通过 compile() 生成，生成后不可修改。
+ * 所有状态存放在一块连续内存中，按状态编号（即数组下标）索引：
+ * 状态 s 经过字节 c 到达的子状态为 t = base[s] + c，当且仅当 check[t] == s 时有效。
+ * 每一步只需两次数组访问，没有哈希查找，也没有指针追踪。
+ */
+class CompiledTrie {
+public:
+    static constexpr int32_t kNoState = -1;
+    static constexpr int32_t kRootState = 0;
+
+    /**
+     * @brief 随状态表一起保存的词表设置；自动机中的脏话已按这些设置折叠和归一化，加载后必须沿用
+     */
+    struct FileSettings {
+        bool utf8Mode = false;
+        std::optional<NormalizationOptions> normalization; // 未开启混淆归一化时为空
+        uint64_t normalizerFingerprint = 0;                // ObfuscationNormalizer::fingerprint，包含自定义映射
+        std::vector<WordTag> tags;                         // 按脏话编号索引的类别和严重程度，可以比编号数短
+    };
+
+    CompiledTrie() {
+        auto empty = std::make_shared<std::vector<Slot>>(kAlphabetSize + 1);
+        (*empty)[kRootState].check = kRootCheck;
+        table = empty->data();
+        tableSize = empty->size();
+        storage = std::move(empty);
+    }
+
+    /**
+     * @brief 从可变字典树生成双数组
+     * @param root 字典树根节点
+     */
+    static CompiledTrie compile(const TrieNode& root) {
+        CompiledTrie trie;
+        Builder builder(trie);
+        builder.build(root);
+        return trie;
+    }
+
+    /**
+     * @brief 还原出可变字典树，用于编译后继续添加脏话
+     */
+    std::unique_ptr<TrieArena> decompile(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) const {
+        auto arena = std::make_unique<TrieArena>(upstream);
+        std::vector<std::pair<int32_t, TrieNode*>> stack = {{kRootState, arena->root()}};
+        while (!stack.empty()) {
+            auto [state, node] = stack.back();
+            stack.pop_back();
+            node->isEndOfWord = isEndOfWord(state);
+            node->patternId = patternId(state);
+            node->boundary = boundary(state);
+            node->isAllowed = isAllowed(state);
+            for (int c = 0; c < kAlphabetSize; ++c) {
+                int32_t next = child(state, static_cast<unsigned char>(c));
+                if (next != kNoState) {
+                    TrieNode* childNode = arena->newNode();
+                    node->children[static_cast<char>(c)] = childNode;
+                    stack.emplace_back(next, childNode);
+                }
+            }
+        }
+        return arena;
+    }
+
+    /**
+     * @brief 沿字典树前进一步（goto 函数）
+     * @return 子状态，不存在时返回 kNoState
+     */
+    int32_t child(int32_t state, unsigned char c) const {
+        int32_t next = table[state].base + c;
+        return table[next].check == state ? next : kNoState;
+    }
+
+    /**
+     * @brief Aho-Corasick 状态转移：子状态不存在时沿失败指针回退
+     */
+    int32_t step(int32_t state, unsigned char c) const {
+        while (true) {
+            int32_t next = child(state, c);
+            if (next != kNoState) {
+                return next;
+            }
+            if (state == kRootState) {
+                return kRootState;
+            }
+            state = table[state].fail;
+        }
+    }
+
+    bool isEndOfWord(int32_t state) const {
+        return (table[state].info & kEndOfWordBit) != 0;
+    }
+
+    /**
+     * @brief 词尾状态对应的脏话编号
+     */
+    uint32_t patternId(int32_t state) const {
+        return table[state].pattern;
+    }
+
+    /**
+     * @brief 词尾状态对应的脏话的边界要求
+     */
+    BoundaryMode boundary(int32_t state) const {
+        return static_cast<BoundaryMode>((table[state].info & kBoundaryMask) >> kBoundaryShift);
+    }
+
+    /**
+     * @brief 是否有脏话带有边界要求；没有时扫描不需要检查边界
+     */
+    bool hasBoundaryRules() const {
+        return hasBoundaries;
+    }
+
+    /**
+     * @brief 词尾状态是否是白名单短语：它不输出，而是取消与之重叠的匹配
+     */
+    bool isAllowed(int32_t state) const {
+        return (table[state].info & kAllowedBit) != 0;
+    }
+
+    bool hasAllowRules() const {
+        return hasAllowlist;
+    }
+
+    /**
+     * @brief 状态对应前缀的长度
+     */
+    uint32_t depth(int32_t state) const {
+        return table[state].info & kDepthMask;
+    }
+
+    /**
+     * @brief 输出指针：沿失败链遇到的第一个词尾状态，没有时为根状态
+     */
+    int32_t output(int32_t state) const {
+        return table[state].output;
+    }
+
+    /**
+     * @brief 到达该状态时，是否有词在当前位置结束
+     */
+    bool hasMatch(int32_t state) const {
+        return isEndOfWord(state) || table[state].output != kRootState;
+    }
+
+    size_t longestWordLength() const {
+        return maxWordLength;
+    }
+
+    /**
+     * @brief 扫描用的环形缓冲区大小：不小于 longestWordLength() + 1（有白名单时为两倍）的 2 的幂，下标用位与计算
+     */
+    size_t windowSize() const {
+        return windowMask + 1;
+    }
+
+    /**
+     * @brief 由根状态的子状态生成的首字节预过滤器
+     */
+    const FirstBytePrefilter& prefilter() const {
+        return firstBytes;
+    }
+
+    size_t stateCount() const {
+        return usedStates;
+    }
+
+    size_t memoryUsage() const {
+        return tableSize * sizeof(Slot);
+    }
+
+    /**
+     * @brief 以二进制格式写出编译结果，供 load 直接映射使用
+     *
+     * 格式：64 字节文件头（魔数、版本、字节序标记、状态数、校验和等），随后是状态表，
+     * 最后是每个脏话编号两个字节的标签（严重程度、类别）。状态之间只用下标引用，与加载地址无关。
+     * @param patternCount 所属过滤器已分配的脏话编号数，加载时原样返回
+     * @param settings 构建自动机时的 UTF-8 和归一化设置以及脏话标签，加载时原样返回
+     */
+    bool save(std::ostream& out, uint32_t patternCount, const FileSettings& settings) const {
+        FileHeader header;
+        std::memcpy(header.magic, kFileMagic, sizeof(header.magic));
+        header.version = kFileVersion;
+        header.byteOrder = kByteOrderMark;
+        header.slotSize = sizeof(Slot);
+        header.patternCount = patternCount;
+        header.slotCount = tableSize;
+        header.checksum = checksum(table, tableSize * sizeof(Slot));
+        header.utf8Mode = settings.utf8Mode ? 1 : 0;
+        if (settings.normalization) {
+            header.normalization = static_cast<uint8_t>(1u | (settings.normalization->leetspeak ? 2u : 0u) |
+                                                        (settings.normalization->collapseRepeats ? 4u : 0u) |
+                                                        (settings.normalization->stripSeparators ? 8u : 0u));
+            header.normalizerFingerprint = settings.normalizerFingerprint;
+        }
+        std::vector<uint8_t> tagBytes;
+        tagBytes.reserve(settings.tags.size() * 2);
+        for (const WordTag& tag : settings.tags) {
+            tagBytes.push_back(static_cast<uint8_t>(tag.severity));
+            tagBytes.push_back(tag.category);
+        }
+        header.tagCount = static_cast<uint32_t>(settings.tags.size());
+        header.tagChecksum = checksum(tagBytes.data(), tagBytes.size());
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(table), static_cast<std::streamsize>(tableSize * sizeof(Slot)));
+        out.write(reinterpret_cast<const char*>(tagBytes.data()), static_cast<std::streamsize>(tagBytes.size()));
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief 加载 save 写出的文件
+     *
+     * 在支持的平台上用 mmap 映射文件，状态表直接在映射的内存上使用，不做解析和复制。
+     * 加载时检查版本、字节序、校验和以及各状态的下标范围，损坏的文件会被拒绝。
+     * @return false 如果文件无法读取或格式不正确，此时 trie 不变
+     */
+    static bool load(const std::string& filename, CompiledTrie& trie, uint32_t& patternCount, FileSettings& settings) {
+        std::shared_ptr<const void> data;
+        size_t size = 0;
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(FileHeader)) {
+            size = static_cast<size_t>(info.st_size);
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = std::shared_ptr<const void>(mapped, [size](const void* p) {
+                    ::munmap(const_cast<void*>(p), size);
+                });
+            }
+        }
+        ::close(fd);
+#endif
+        if (!data) {
+            // 不支持 mmap 时读入内存；按 Slot 分配以保证对齐
+            std::ifstream in(filename, std::ios::binary);
+            if (!in.is_open()) {
+                return false;
+            }
+            in.seekg(0, std::ios::end);
+            size = static_cast<size_t>(in.tellg());
+            in.seekg(0, std::ios::beg);
+            auto buffer = std::make_shared<std::vector<Slot>>((size + sizeof(Slot) - 1) / sizeof(Slot));
+            if (!in.read(reinterpret_cast<char*>(buffer->data()), static_cast<std::streamsize>(size))) {
+                return false;
+            }
+            data = std::shared_ptr<const void>(buffer, buffer->data());
+        }
+
+        if (size < sizeof(FileHeader)) {
+            return false;
+        }
+        FileHeader header;
+        std::memcpy(&header, data.get(), sizeof(header));
+        if (std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) != 0 || header.version != kFileVersion ||
+            header.byteOrder != kByteOrderMark || header.slotSize != sizeof(Slot) ||
+            header.slotCount < kAlphabetSize + 1 ||
+            header.slotCount > (size - sizeof(FileHeader)) / sizeof(Slot) || header.utf8Mode > 1 ||
+            header.normalization > 15 || (header.normalization > 1 && (header.normalization & 1u) == 0)) {
+            return false;
+        }
+
+        const auto* slots = reinterpret_cast<const Slot*>(static_cast<const char*>(data.get()) + sizeof(FileHeader));
+        size_t slotCount = static_cast<size_t>(header.slotCount);
+        if (checksum(slots, slotCount * sizeof(Slot)) != header.checksum) {
+            return false;
+        }
+        const auto* tagBytes = reinterpret_cast<const uint8_t*>(slots + slotCount);
+        size_t tagSpace = size - sizeof(FileHeader) - slotCount * sizeof(Slot);
+        if (header.tagCount > header.patternCount || tagSpace / 2 < header.tagCount ||
+            checksum(tagBytes, size_t(header.tagCount) * 2) != header.tagChecksum) {
+            return false;
+        }
+        std::vector<WordTag> tags(header.tagCount);
+        for (size_t i = 0; i < tags.size(); ++i) {
+            if (tagBytes[2 * i] > static_cast<uint8_t>(Severity::Block)) {
+                return false;
+            }
+            tags[i] = {static_cast<Severity>(tagBytes[2 * i]), tagBytes[2 * i + 1]};
+        }
+
+        CompiledTrie loaded;
+        loaded.storage = std::move(data);
+        loaded.table = slots;
+        loaded.tableSize = slotCount;
+        if (!loaded.validate()) {
+            return false;
+        }
+        loaded.updateWindow();
+        loaded.buildPrefilter();
+        trie = std::move(loaded);
+        patternCount = header.patternCount;
+        settings = FileSettings();
+        settings.utf8Mode = header.utf8Mode != 0;
+        settings.tags = std::move(tags);
+        if (header.normalization & 1u) {
+            NormalizationOptions options;
+            options.leetspeak = (header.normalization & 2u) != 0;
+            options.collapseRepeats = (header.normalization & 4u) != 0;
+            options.stripSeparators = (header.normalization & 8u) != 0;
+            settings.normalization = options;
+            settings.normalizerFingerprint = header.normalizerFingerprint;
+        }
+        return true;
+    }
+
+    // 环形缓冲区中某个起始位置目前已知的最长匹配
+    struct Candidate {
+        uint32_t length;
+        uint32_t pattern;
+        uint32_t allowed;    // 从该位置开始的最长白名单短语的长度
+        bool boundaryBefore; // 该起始位置之前是否是单词边界
+    };
+
+    /**
+     * @brief 跨多段文本连续扫描时需要保留的状态，偏移均相对于整个文本
+     */
+    struct ScanState {
+        int32_t state = kRootState;
+        size_t next = 0;               // 小于 next 的位置都已做出决定
+        int32_t deferred = kRootState; // 上一个字节之后的状态，其整词输出在等待右侧的边界
+        unsigned char lastByte = 0;    // 上一段的最后一个字节
+        size_t protectedUntil = 0;     // 已确定的白名单短语覆盖到的位置，其前的匹配被取消
+    };
+
+    /**
+     * @brief 单次扫描，按从左到右、最长匹配的规则输出要屏蔽的区间
+     *
+     * longest 是大小为 windowSize() 的环形缓冲区，记录每个起始位置
+     * 已知的最长匹配。当前状态深度为 d 时，起点早于 j + 1 - d 的位置
+     * 不会再有新的匹配，可以立即做出决定。emit 只会覆盖已经读过的字节，
+     * 因此可以在回调里直接修改原文。
+     * @param text 原文，扫描时逐字节做大小写折叠
+     * @param emit 回调 emit(start, length, patternId)
+     */
+    template <typename Emit>
+    void scanLongest(std::string_view text, Emit&& emit) const {
+        withCandidateWindow([&](Candidate* longest) {
+            ScanState scan;
+            scanChunk(text, 0, true, scan, longest, emit);
+            finishScan(text.length(), scan, longest, emit);
+        });
+    }
+
+    /**
+     * @brief UTF-8 模式的 scanLongest：原文按块经 Utf8CaseFolder 折叠后再扫描
+     *
+     * 折叠不改变字节数，emit 给出的偏移直接对应原文。块在栈上，不分配堆内存。
+     */
+    template <typename Emit>
+    void scanLongestUtf8(std::string_view text, Emit&& emit) const {
+        withCandidateWindow([&](Candidate* longest) {
+            ScanState scan;
+            forEachFoldedBlock(text, [&](std::string_view block, size_t base, bool last) {
+                scanChunk(block, base, last, scan, longest, emit);
+                return true;
+            });
+            finishScan(text.length(), scan, longest, emit);
+        });
+    }
+
+    /**
+     * @brief 可以提前停止的扫描：emit 返回 false 后，读完当前的小块即返回
+     *
+     * 在停止之前输出的匹配与 scanLongest / scanLongestUtf8 / scanNormalized 相同，
+     * 停止时不再读取之后的文本。
+     * @param normalizer 不为空时做混淆归一化，含义同 scanNormalized
+     * @param emit 回调 emit(start, length, patternId)，返回 false 表示不再需要更多匹配
+     * @return 是否扫描完了整个文本
+     */
+    template <typename Emit>
+    bool scanLongestUntil(std::string_view text, bool utf8, const ObfuscationNormalizer* normalizer,
+                          Emit&& emit) const {
+        bool stopped = false;
+        auto onMatch = [&](size_t start, size_t length, uint32_t patternId) {
+            stopped = stopped || !emit(start, length, patternId);
+        };
+        auto scanBlocks = [&](auto&& scanBlock, std::string_view block, size_t base, bool last) {
+            for (size_t offset = 0; offset < block.length() && !stopped; offset += kStopBlockSize) {
+                scanBlock(block.substr(offset, kStopBlockSize), base + offset,
+                          last && offset + kStopBlockSize >= block.length());
+            }
+            return !stopped;
+        };
+        if (normalizer) {
+            withNormalizedWindow([&](const NormalizedWindow& window) {
+                NormalizedScanState scan;
+                auto scanBlock = [&](std::string_view block, size_t base, bool) {
+                    scanNormalizedChunk<false>(block, base, *normalizer, scan, window, onMatch);
+                };
+                if (utf8) {
+                    forEachFoldedBlock(text, [&](std::string_view block, size_t base, bool last) {
+                        return scanBlocks(scanBlock, block, base, last);
+                    });
+                } else {
+                    scanBlocks(scanBlock, text, 0, true);
+                }
+                if (!stopped) {
+                    finishNormalized(scan, window, onMatch);
+                }
+            });
+        } else {
+            withCandidateWindow([&](Candidate* longest) {
+                ScanState scan;
+                auto scanBlock = [&](std::string_view block, size_t base, bool last) {
+                    scanChunk(block, base, last, scan, longest, onMatch);
+                };
+                if (utf8) {
+                    forEachFoldedBlock(text, [&](std::string_view block, size_t base, bool last) {
+                        return scanBlocks(scanBlock, block, base, last);
+                    });
+                } else {
+                    scanBlocks(scanBlock, text, 0, true);
+                }
+                if (!stopped) {
+                    finishScan(text.length(), scan, longest, onMatch);
+                }
+            });
+        }
+        return !stopped;
+    }
+
+    /**
+     * @brief 两个自动机一起扫描同一段文本：按块交替推进，每块读入缓存后依次交给两个自动机
+     *
+     * 结果与分别调用 scanLongest（utf8 为 true 时 scanLongestUtf8）相同。
+     * 两个自动机读的是同一块原文，emit 不能修改原文。
+     * @param emitFirst 回调 emitFirst(start, length, patternId)，输出 first 的匹配
+     * @param emitSecond 输出 second 的匹配
+     */
+    template <typename EmitFirst, typename EmitSecond>
+    static void scanLongestPair(const CompiledTrie& first, const CompiledTrie& second, std::string_view text,
+                                bool utf8, EmitFirst&& emitFirst, EmitSecond&& emitSecond) {
+        first.withCandidateWindow([&](Candidate* firstLongest) {
+            second.withCandidateWindow([&](Candidate* secondLongest) {
+                ScanState firstScan;
+                ScanState secondScan;
+                auto visit = [&](std::string_view block, size_t base, bool last) {
+                    first.scanChunk(block, base, last, firstScan, firstLongest, emitFirst);
+                    second.scanChunk(block, base, last, secondScan, secondLongest, emitSecond);
+                    return true;
+                };
+                if (utf8) {
+                    forEachFoldedBlock(text, visit);
+                } else {
+                    for (size_t pos = 0; pos < text.length(); pos += kFoldBlockSize) {
+                        visit(text.substr(pos, kFoldBlockSize), pos, pos + kFoldBlockSize >= text.length());
+                    }
+                }
+                first.finishScan(text.length(), firstScan, firstLongest, emitFirst);
+                second.finishScan(text.length(), secondScan, secondLongest, emitSecond);
+            });
+        });
+    }
+
+    /**
+     * @brief 是否存在任意匹配，遇到第一个匹配即返回
+     *
+     * 有白名单时匹配可能被之后读到的白名单短语取消，需要和 scanLongest 一样完整扫描。
+     */
+    bool containsMatch(std::string_view text) const {
+        if (hasAllowlist) {
+            bool found = false;
+            scanLongest(text, [&](size_t, size_t, uint32_t) { found = true; });
+            return found;
+        }
+        if (hasBoundaries) {
+            return containsWithBoundaries(text, false);
+        }
+        int32_t state = kRootState;
+        return findAny(text, true, state);
+    }
+
+    bool containsMatchUtf8(std::string_view text) const {
+        if (hasAllowlist) {
+            bool found = false;
+            scanLongestUtf8(text, [&](size_t, size_t, uint32_t) { found = true; });
+            return found;
+        }
+        if (hasBoundaries) {
+            return containsWithBoundaries(text, true);
+        }
+        int32_t state = kRootState;
+        bool found = false;
+        forEachFoldedBlock(text, [&](std::string_view block, size_t, bool last) {
+            found = findAny(block, last, state);
+            return !found;
+        });
+        return found;
+    }
+
+    /**
+     * @brief 依次访问文本中每一处脏话的出现，包括相互重叠的和互为前后缀的，visit 返回 false 时停止
+     *
+     * 按结束位置的顺序访问，同一位置结束的按长度从长到短；不检查边界要求，也不处理白名单，
+     * 由调用方决定取舍。
+     * @param visit 回调 visit(start, length, patternId)
+     * @return 是否扫描到了文本末尾（visit 没有要求停止）
+     */
+    template <typename Visit>
+    bool forEachOccurrence(std::string_view text, Visit&& visit) const {
+        int32_t state = kRootState;
+        for (size_t i = 0; i < text.length(); ++i) {
+            if (state == kRootState) {
+                i = firstBytes.nextCandidate(text.data(), text.length(), i);
+                if (i == text.length()) {
+                    break;
+                }
+            }
+            state = step(state, foldCase(static_cast<unsigned char>(text[i])));
+            for (int32_t s = isEndOfWord(state) ? state : output(state); s != kRootState; s = output(s)) {
+                if (!isAllowed(s) && !visit(i + 1 - depth(s), depth(s), patternId(s))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 扫描整个文本中从 base 开始的一段，状态保存在 scan 中
+     *
+     * 依次对相邻的各段调用，再调用一次 finishScan，结果与一次扫描整个文本相同。
+     * emit 给出的偏移相对于整个文本，可能落在之前的段中，但不会超过已读过的字节。
+     * 返回时 scan.next 之前的字节都已确定，之后最多还有 longestWordLength() 个字节待定。
+     * 带边界要求的脏话在记录候选时检查边界：起点之前的字节在读到起点时记下，
+     * 整词要求的右侧边界在读到下一个字节（或文本结束）时检查。
+     * @param last 是否为最后一段；不是时段尾的字节可能和下一段组成脏话，预过滤器不能跳过
+     * @param longest 大小为 windowSize() 的环形缓冲区，在各段之间保持不变
+     * @tparam kFirstOnly 为 true 时记录到第一个匹配即返回 true，不输出匹配
+     */
+    template <bool kFirstOnly = false, typename Emit>
+    bool scanChunk(std::string_view chunk, size_t base, bool last, ScanState& scan, Candidate* longest,
+                   Emit&& emit) const {
+        const size_t mask = windowMask;
+        int32_t state = scan.state;
+        size_t next = scan.next;
+        int32_t deferred = scan.deferred;
+        size_t protectedUntil = scan.protectedUntil;
+        bool found = false;
+
+        for (size_t i = 0; i < chunk.length(); ++i) {
+            if (state == kRootState) {
+                // 处于根状态时，不是候选起点的字节不会改变状态，可以整段跳过
+                i = firstBytes.nextCandidate(chunk.data(), chunk.length(), i);
+                if (i == chunk.length() && !last && i > 0 &&
+                    firstBytes.mayStart(static_cast<unsigned char>(chunk[i - 1]))) {
+                    --i; // 前两个字节判断需要下一段的首字节
+                }
+                next = base + i;
+                if (i == chunk.length()) {
+                    break;
+                }
+            }
+            size_t j = base + i;
+            unsigned char c = foldCase(static_cast<unsigned char>(chunk[i]));
+            if (deferred != kRootState) {
+                found |= !isWordByte(c) && recordOutputs(deferred, j - 1, longest, true).matched;
+                deferred = kRootState;
+            }
+            Candidate& start = longest[j & mask];
+            start.length = 0;
+            start.allowed = 0;
+            start.boundaryBefore =
+                hasBoundaries && !isWordByte(i > 0 ? static_cast<unsigned char>(chunk[i - 1]) : scan.lastByte);
+            state = step(state, c);
+
+            Recorded recorded{false, false};
+            if (hasMatch(state)) {
+                recorded = recordOutputs(state, j, longest, false);
+            }
+            if (recorded.deferred) {
+                deferred = state;
+            }
+            found |= recorded.matched;
+            if (kFirstOnly && found) {
+                break;
+            }
+
+            settleCandidates(j + 1 - depth(state), next, protectedUntil, longest, emit);
+        }
+
+        scan.state = state;
+        scan.next = next;
+        scan.deferred = deferred;
+        scan.protectedUntil = protectedUntil;
+        if (!chunk.empty()) {
+            scan.lastByte = static_cast<unsigned char>(chunk.back());
+        }
+        return found;
+    }
+
+    /**
+     * @brief 文本结束，输出所有待定的匹配
+     * @param length 整个文本的长度
+     */
+    template <typename Emit>
+    void finishScan(size_t length, ScanState& scan, Candidate* longest, Emit&& emit) const {
+        if (scan.deferred != kRootState) {
+            recordOutputs(scan.deferred, length - 1, longest, true); // 文本末尾是边界
+        }
+        settleCandidates(length, scan.next, scan.protectedUntil, longest, emit);
+        scan.state = kRootState;
+        scan.deferred = kRootState;
+    }
+
+    /**
+     * @brief 混淆归一化扫描在各段之间保留的状态，scan.next 是归一化后的位置
+     */
+    struct NormalizedScanState {
+        ScanState scan;
+        size_t position = 0;                              // 已产生的归一化字节数
+        int previous = ObfuscationNormalizer::kSeparator; // 上一个归一化字节，用于折叠重复
+    };
+
+    /**
+     * @brief 归一化位置到原文偏移的映射，三个数组都是大小为 windowSize() 的环形缓冲区
+     */
+    struct NormalizedWindow {
+        Candidate* longest;
+        size_t* begin; // 归一化字节来自的原文偏移
+        size_t* end;   // 归一化字节及其后被折叠的重复字节之后的原文偏移
+    };
+
+    /**
+     * @brief 带混淆归一化的 scanLongest：读取原文时逐字节查 normalizer 的表，直接驱动自动机
+     *
+     * 分隔符不进入自动机；与上一个字母相同、且当前状态没有对应转移的字母被跳过，
+     * 因此 "fuuuck" 匹配 "fuck"，而 "as" 不匹配 "ass"。归一化位置通过环形缓冲区映射回原文，
+     * emit 给出的区间覆盖脏话在原文中的全部字节（包括中间的分隔符和重复字母），
+     * 最长 normalizedSpanLimit() 个字节。脏话本身应已经过 normalizer.normalize 处理。不生成归一化后的文本。
+     * @param utf8 是否先按块做 UTF-8 大小写折叠
+     */
+    template <typename Emit>
+    void scanNormalized(std::string_view text, const ObfuscationNormalizer& normalizer, bool utf8,
+                        Emit&& emit) const {
+        withNormalizedWindow([&](const NormalizedWindow& window) {
+            NormalizedScanState scan;
+            if (utf8) {
+                forEachFoldedBlock(text, [&](std::string_view block, size_t base, bool) {
+                    scanNormalizedChunk<false>(block, base, normalizer, scan, window, emit);
+                    return true;
+                });
+            } else {
+                scanNormalizedChunk<false>(text, 0, normalizer, scan, window, emit);
+            }
+            finishNormalized(scan, window, emit);
+        });
+    }
+
+    /**
+     * @brief 归一化后是否存在任意匹配，遇到第一个匹配即返回
+     */
+    bool containsNormalized(std::string_view text, const ObfuscationNormalizer& normalizer, bool utf8) const {
+        bool found = false;
+        if (hasAllowlist) {
+            scanNormalized(text, normalizer, utf8, [&](size_t, size_t, uint32_t) { found = true; });
+            return found;
+        }
+        withNormalizedWindow([&](const NormalizedWindow& window) {
+            NormalizedScanState scan;
+            auto ignore = [](size_t, size_t, uint32_t) {};
+            if (utf8) {
+                forEachFoldedBlock(text, [&](std::string_view block, size_t base, bool) {
+                    found = scanNormalizedChunk<true>(block, base, normalizer, scan, window, ignore);
+                    return !found;
+                });
+            } else {
+                found = scanNormalizedChunk<true>(text, 0, normalizer, scan, window, ignore);
+            }
+            if (!found && scan.scan.deferred != kRootState) {
+                found = recordOutputs(scan.scan.deferred, scan.position - 1, window.longest, true).matched;
+            }
+        });
+        return found;
+    }
+
+    /**
+     * @brief 归一化扫描原文中从 base 开始的一段，用法同 scanChunk
+     *
+     * emit 给出的是原文偏移。返回时归一化位置 scan.scan.next 之前的匹配都已输出。
+     * @tparam kFirstOnly 为 true 时遇到第一个匹配即返回 true，不输出匹配
+     */
+    template <bool kFirstOnly, typename Emit>
+    bool scanNormalizedChunk(std::string_view chunk, size_t base, const ObfuscationNormalizer& normalizer,
+                             NormalizedScanState& scan, const NormalizedWindow& window, Emit&& emit) const {
+        const size_t mask = windowMask;
+        int32_t state = scan.scan.state;
+        size_t next = scan.scan.next;
+        size_t position = scan.position;
+        int previous = scan.previous;
+        int32_t deferred = scan.scan.deferred;
+        size_t protectedUntil = scan.scan.protectedUntil;
+        const size_t spanLimit = normalizedSpanLimit();
+        bool found = false;
+
+        for (size_t i = 0; i < chunk.length(); ++i) {
+            if (next != position && base + i - window.begin[next & mask] >= spanLimit) {
+                // 待定的匹配在原文中跨越太长（通常是一长串分隔符或重复字母），在这里断开，如同文本结束
+                if (deferred != kRootState) {
+                    found |= recordOutputs(deferred, position - 1, window.longest, true).matched;
+                    deferred = kRootState;
+                }
+                if (kFirstOnly && found) {
+                    break;
+                }
+                settleNormalized(position, next, protectedUntil, window, emit);
+                state = kRootState;
+            }
+            int c = normalizer.map(static_cast<unsigned char>(chunk[i]));
+            if (c == ObfuscationNormalizer::kSeparator) {
+                continue;
+            }
+            if (c == previous && normalizer.collapses(c) && child(state, static_cast<unsigned char>(c)) == kNoState) {
+                // 自动机不需要的重复字母不产生新的位置，只延长上一个位置覆盖的原文
+                window.end[(position - 1) & mask] = base + i + 1;
+                continue;
+            }
+            const int before = previous;
+            previous = c;
+
+            size_t j = position++;
+            if (state == kRootState && !firstBytes.mayStart(static_cast<unsigned char>(c))) {
+                next = position; // 不是候选起点，状态不变；有待定的整词输出时不会处于根状态
+                continue;
+            }
+            if (deferred != kRootState) {
+                found |= !ObfuscationNormalizer::isWordByte(c) &&
+                         recordOutputs(deferred, j - 1, window.longest, true).matched;
+                deferred = kRootState;
+            }
+            const size_t slot = j & mask;
+            window.begin[slot] = base + i;
+            window.end[slot] = base + i + 1;
+            window.longest[slot].length = 0;
+            window.longest[slot].allowed = 0;
+            // 边界按归一化后的字节判断，被丢弃的分隔符不算边界
+            window.longest[slot].boundaryBefore = hasBoundaries && !ObfuscationNormalizer::isWordByte(before);
+            state = step(state, static_cast<unsigned char>(c));
+
+            Recorded recorded{false, false};
+            if (hasMatch(state)) {
+                recorded = recordOutputs(state, j, window.longest, false);
+            }
+            if (recorded.deferred) {
+                deferred = state;
+            }
+            found |= recorded.matched;
+            if (kFirstOnly && found) {
+                break;
+            }
+
+            settleNormalized(j + 1 - depth(state), next, protectedUntil, window, emit);
+        }
+
+        scan.scan.state = state;
+        scan.scan.next = next;
+        scan.scan.deferred = deferred;
+        scan.scan.protectedUntil = protectedUntil;
+        scan.position = position;
+        scan.previous = previous;
+        return found;
+    }
+
+    /**
+     * @brief 归一化扫描中一个待定的匹配在原文中最多跨越的字节数
+     *
+     * 最长的词中间还可以夹杂 kMaxSkippedBytes 个分隔符或被折叠的重复字母；超过时候选被放弃，
+     * 流式屏蔽因此最多保留这么多字节。
+     */
+    size_t normalizedSpanLimit() const {
+        return windowSize() + kMaxSkippedBytes;
+    }
+
+    /**
+     * @brief 文本结束，输出 scanNormalizedChunk 所有待定的匹配并重置状态
+     */
+    template <typename Emit>
+    void finishNormalized(NormalizedScanState& scan, const NormalizedWindow& window, Emit&& emit) const {
+        if (scan.scan.deferred != kRootState) {
+            recordOutputs(scan.scan.deferred, scan.position - 1, window.longest, true);
+        }
+        settleNormalized(scan.position, scan.scan.next, scan.scan.protectedUntil, window, emit);
+        scan = NormalizedScanState();
+    }
+
+private:
+    static constexpr int kAlphabetSize = 256;
+    static constexpr size_t kStackWindow = 64; // 最长词不超过该长度时扫描不分配堆内存
+    static constexpr size_t kFoldBlockSize = 4096;
+    static constexpr size_t kStopBlockSize = 256; // scanLongestUntil 每读完这么多字节检查一次是否停止
+    static constexpr size_t kMaxSkippedBytes = 64; // 归一化扫描中一个候选最多再跨越的原文字节数
+    static constexpr int32_t kRootCheck = -2; // 根状态不是任何状态的子状态
+    static constexpr uint32_t kEndOfWordBit = 0x80000000u;
+    static constexpr uint32_t kBoundaryShift = 29;
+    static constexpr uint32_t kBoundaryMask = 0x60000000u;
+    static constexpr uint32_t kAllowedBit = 0x10000000u;
+    static constexpr uint32_t kDepthMask = 0x0fffffffu;
+
+    struct Slot {
+        int32_t base = 0;
+        int32_t check = kNoState;
+        int32_t fail = kRootState;
+        int32_t output = kRootState;
+        uint32_t info = 0; // 最高位为词尾标记，其后两位为边界要求，再一位为白名单标记，其余为深度
+        uint32_t pattern = 0;
+    };
+
+    static constexpr char kFileMagic[8] = {'P', 'F', 'T', 'R', 'I', 'E', '\r', '\n'};
+    static constexpr uint32_t kFileVersion = 3;
+    static constexpr uint32_t kByteOrderMark = 0x01020304u;
+
+    // 文件头，大小固定为 64 字节，状态表紧随其后
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder; // 写入机器的字节序，不同字节序的机器不能直接使用
+        uint32_t slotSize;
+        uint32_t patternCount;
+        uint64_t slotCount;
+        uint64_t checksum;
+        uint8_t utf8Mode = 0;
+        uint8_t normalization = 0; // 最低位表示开启归一化，其后三位依次为 leetspeak、collapseRepeats、stripSeparators
+        uint8_t padding[2] = {};
+        uint32_t tagCount = 0; // 状态表之后的标签个数
+        uint64_t normalizerFingerprint = 0;
+        uint64_t tagChecksum = 0;
+    };
+    static_assert(sizeof(FileHeader) == 64, "FileHeader must stay 64 bytes");
+
+    // 状态表存放在 storage 持有的内存中：编译生成的 std::vector，或 loadCompiled 映射的文件。
+    // 编译完成后只读，复制 CompiledTrie 时共享同一份内存
+    std::shared_ptr<const void> storage;
+    const Slot* table = nullptr;
+    size_t tableSize = 0;
+    FirstBytePrefilter firstBytes;
+    size_t maxWordLength = 0;
+    size_t windowMask = 0;
+    size_t usedStates = 1;
+    bool hasBoundaries = false;
+    bool hasAllowlist = false;
+
+    /**
+     * @brief 提供大小为 windowSize() 的候选环形缓冲区，较短时位于栈上
+     */
+    template <typename Body>
+    void withCandidateWindow(Body&& body) const {
+        const size_t window = windowSize();
+        Candidate stackBuffer[kStackWindow];
+        std::vector<Candidate> heapBuffer;
+        Candidate* longest = stackBuffer;
+        if (window > kStackWindow) {
+            heapBuffer.resize(window);
+            longest = heapBuffer.data();
+        }
+        body(longest);
+    }
+
+    /**
+     * @brief 提供归一化扫描所需的三个环形缓冲区，较短时位于栈上
+     */
+    template <typename Body>
+    void withNormalizedWindow(Body&& body) const {
+        withCandidateWindow([&](Candidate* longest) {
+            const size_t size = windowSize();
+            size_t stackOffsets[2 * kStackWindow];
+            std::vector<size_t> heapOffsets;
+            size_t* offsets = stackOffsets;
+            if (size > kStackWindow) {
+                heapOffsets.resize(2 * size);
+                offsets = heapOffsets.data();
+            }
+            body(NormalizedWindow{longest, offsets, offsets + size});
+        });
+    }
+
+    // recordOutputs 的结果
+    struct Recorded {
+        bool matched;  // 记录了至少一个候选
+        bool deferred; // 还有整词要求的输出在等待右侧的边界
+    };
+
+    /**
+     * @brief 把状态 state 在位置 j 结束的输出记入候选缓冲区，同时检查各自的边界要求
+     * @param wholeWords 为 false 时记录没有整词要求的输出；为 true 时只记录整词要求的输出，
+     *                   调用方已确认 j 之后是边界
+     */
+    Recorded recordOutputs(int32_t state, size_t j, Candidate* longest, bool wholeWords) const {
+        const size_t mask = windowMask;
+        Recorded recorded{false, false};
+        for (int32_t out = isEndOfWord(state) ? state : output(state); out != kRootState; out = output(out)) {
+            BoundaryMode mode = boundary(out);
+            if ((mode == BoundaryMode::WholeWord) != wholeWords) {
+                recorded.deferred = recorded.deferred || mode == BoundaryMode::WholeWord;
+                continue;
+            }
+            uint32_t length = depth(out);
+            Candidate& best = longest[(j + 1 - length) & mask];
+            if (isAllowed(out)) {
+                best.allowed = std::max(best.allowed, length);
+                continue;
+            }
+            if (mode != BoundaryMode::Substring && !best.boundaryBefore) {
+                continue;
+            }
+            recorded.matched = true;
+            if (length > best.length) {
+                best.length = length;
+                best.pattern = patternId(out);
+            }
+        }
+        return recorded;
+    }
+
+    /**
+     * @brief 对归一化位置 limit 之前的起点做出决定，把匹配换算为原文区间后输出
+     */
+    template <typename Emit>
+    void settleNormalized(size_t limit, size_t& next, size_t& protectedUntil, const NormalizedWindow& window,
+                          Emit& emit) const {
+        const size_t mask = windowMask;
+        auto emitOriginal = [&](size_t start, size_t length, uint32_t pattern) {
+            size_t begin = window.begin[start & mask];
+            size_t end = window.end[(start + length - 1) & mask];
+            emit(begin, end - begin, pattern);
+        };
+        settleCandidates(limit, next, protectedUntil, window.longest, emitOriginal);
+    }
+
+    /**
+     * @brief 对 limit 之前的起点做出决定：每个起点取最长的匹配，输出后跳过匹配覆盖的字节
+     *
+     * 有白名单时，匹配要等到起点落在其范围内的白名单短语都已确定（start + length <= limit）
+     * 才能决定；与白名单短语重叠的匹配被丢弃。protectedUntil 是已确定的白名单短语覆盖到的位置。
+     */
+    template <typename Emit>
+    void settleCandidates(size_t limit, size_t& next, size_t& protectedUntil, const Candidate* longest,
+                          Emit& emit) const {
+        const size_t mask = windowMask;
+        while (next < limit) {
+            const Candidate& best = longest[next & mask];
+            if (hasAllowlist) {
+                protectedUntil = std::max<size_t>(protectedUntil, next + best.allowed);
+                if (best.length > 0) {
+                    if (next + best.length > limit) {
+                        return; // 还有可能与它重叠的白名单短语没有读完
+                    }
+                    if (next < protectedUntil || allowedWithin(next + 1, next + best.length, longest)) {
+                        ++next;
+                        continue;
+                    }
+                }
+            }
+            if (best.length > 0) {
+                emit(next, static_cast<size_t>(best.length), best.pattern);
+                next += best.length; // 跳过已处理的字符
+            } else {
+                ++next;
+            }
+        }
+    }
+
+    /**
+     * @brief [begin, end) 中是否有白名单短语的起点
+     */
+    bool allowedWithin(size_t begin, size_t end, const Candidate* longest) const {
+        for (size_t pos = begin; pos < end; ++pos) {
+            if (longest[pos & windowMask].allowed > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 把 text 按块折叠，依次调用 visit(block, base, last)，visit 返回 false 时停止
+     */
+    template <typename Visit>
+    static void forEachFoldedBlock(std::string_view text, Visit&& visit) {
+        char folded[kFoldBlockSize];
+        size_t pos = 0;
+        while (pos < text.length()) {
+            size_t length = std::min(kFoldBlockSize, text.length() - pos);
+            size_t done = Utf8CaseFolder::fold(text.data() + pos, length, folded, pos + length == text.length());
+            bool last = pos + done == text.length();
+            if (!visit(std::string_view(folded, done), pos, last)) {
+                return;
+            }
+            pos += done;
+        }
+    }
+
+    /**
+     * @brief 有边界要求时的 containsMatch：到达词尾状态还不够，需要和 scanChunk 一样检查边界
+     */
+    bool containsWithBoundaries(std::string_view text, bool utf8) const {
+        bool found = false;
+        withCandidateWindow([&](Candidate* longest) {
+            ScanState scan;
+            auto ignore = [](size_t, size_t, uint32_t) {};
+            if (utf8) {
+                forEachFoldedBlock(text, [&](std::string_view block, size_t base, bool last) {
+                    found = scanChunk<true>(block, base, last, scan, longest, ignore);
+                    return !found;
+                });
+            } else {
+                found = scanChunk<true>(text, 0, true, scan, longest, ignore);
+            }
+            if (!found && scan.deferred != kRootState) {
+                found = recordOutputs(scan.deferred, text.length() - 1, longest, true).matched;
+            }
+        });
+        return found;
+    }
+
+    /**
+     * @brief 从 state 开始扫描 chunk，state 保存在各段之间
+     * @param last 是否为最后一段，含义同 scanChunk
+     */
+    bool findAny(std::string_view chunk, bool last, int32_t& state) const {
+        for (size_t i = 0; i < chunk.length(); ++i) {
+            if (state == kRootState) {
+                i = firstBytes.nextCandidate(chunk.data(), chunk.length(), i);
+                if (i == chunk.length() && !last && i > 0 &&
+                    firstBytes.mayStart(static_cast<unsigned char>(chunk[i - 1]))) {
+                    --i;
+                }
+                if (i == chunk.length()) {
+                    break;
+                }
+            }
+            state = step(state, foldCase(static_cast<unsigned char>(chunk[i])));
+            if (hasMatch(state)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 每次处理 8 个字节的 64 位校验和，足以发现文件截断和位翻转
+     */
+    static uint64_t checksum(const void* data, size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        uint64_t hash = 0xcbf29ce484222325ull ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * 0x100000001b3ull;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief 检查从文件加载的状态表，保证查询时所有下标都在范围内，并重建统计信息
+     *
+     * 子状态的深度等于父状态加一，失败指针和输出指针指向更浅的状态，
+     * 因此扫描时的深度永远不会超过已读的字节数。
+     */
+    bool validate() {
+        if (table[kRootState].check != kRootCheck || (table[kRootState].info & kDepthMask) != 0) {
+            return false;
+        }
+
+        const auto count = static_cast<int64_t>(tableSize);
+        auto inRange = [&](int64_t state) { return state >= 0 && state < count; };
+        maxWordLength = 0;
+        usedStates = 0;
+        hasBoundaries = false;
+        hasAllowlist = false;
+        for (size_t s = 0; s < tableSize; ++s) {
+            const Slot& slot = table[s];
+            if (slot.check == kNoState) {
+                continue;
+            }
+            ++usedStates;
+            uint32_t depth = slot.info & kDepthMask;
+            if (slot.base < 0 || static_cast<int64_t>(slot.base) + kAlphabetSize >= count ||
+                !inRange(slot.fail) || !inRange(slot.output)) {
+                return false;
+            }
+            if (s != kRootState) {
+                if (!inRange(slot.check) || table[slot.check].check == kNoState ||
+                    depth != (table[slot.check].info & kDepthMask) + 1 ||
+                    (table[slot.fail].info & kDepthMask) >= depth ||
+                    (table[slot.output].info & kDepthMask) >= depth) {
+                    return false;
+                }
+            }
+            uint32_t boundaryBits = (slot.info & kBoundaryMask) >> kBoundaryShift;
+            if (boundaryBits > static_cast<uint32_t>(BoundaryMode::WholeWord)) {
+                return false;
+            }
+            if (slot.info & kEndOfWordBit) {
+                maxWordLength = std::max<size_t>(maxWordLength, depth);
+                hasBoundaries = hasBoundaries || boundaryBits != 0;
+                hasAllowlist = hasAllowlist || (slot.info & kAllowedBit) != 0;
+            }
+        }
+        return true;
+    }
+
+    void updateWindow() {
+        // 有白名单时，匹配要等到与它重叠的白名单短语都读完才能决定，待定的位置最多翻倍
+        const size_t pending = hasAllowlist ? 2 * maxWordLength : maxWordLength;
+        size_t window = 1;
+        while (window < pending + 1) {
+            window <<= 1;
+        }
+        windowMask = window - 1;
+    }
+
+    void buildPrefilter() {
+        for (int c = 0; c < kAlphabetSize; ++c) {
+            int32_t first = child(kRootState, static_cast<unsigned char>(c));
+            if (first == kNoState) {
+                continue;
+            }
+
+            char word[2] = {static_cast<char>(c), 0};
+            if (isEndOfWord(first)) {
+                firstBytes.addWord(std::string_view(word, 1));
+            }
+            for (int d = 0; d < kAlphabetSize; ++d) {
+                if (child(first, static_cast<unsigned char>(d)) != kNoState) {
+                    word[1] = static_cast<char>(d);
+                    firstBytes.addWord(std::string_view(word, 2));
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief 双数组构建器：按广度优先顺序为每个节点寻找可用的 base
+     */
+    class Builder {
+    public:
+        explicit Builder(CompiledTrie& trie) : trie(trie) {}
+
+        void build(const TrieNode& root) {
+            ensureSize(kAlphabetSize + 1);
+            occupy(kRootState, kRootCheck);
+
+            struct Pending {
+                const TrieNode* node;
+                int32_t state;
+            };
+            std::vector<Pending> queue = {{&root, kRootState}};
+            // 广度优先顺序的 (子状态, 父状态, 字节)，用于计算失败指针
+            std::vector<std::tuple<int32_t, int32_t, unsigned char>> edges;
+            std::vector<std::pair<unsigned char, const TrieNode*>> children;
+
+            for (size_t head = 0; head < queue.size(); ++head) {
+                const auto [node, state] = queue[head];
+                if (node->children.empty()) {
+                    continue;
+                }
+
+                children.clear();
+                for (const auto& [c, childNode] : node->children) {
+                    children.emplace_back(static_cast<unsigned char>(c), childNode);
+                }
+                std::sort(children.begin(), children.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                int32_t base = findBase(children);
+                slots[state].base = base;
+                for (const auto& [c, childNode] : children) {
+                    int32_t next = base + c;
+                    occupy(next, state);
+                    Slot& slot = slots[next];
+                    slot.info = (slots[state].info & kDepthMask) + 1;
+                    if (childNode->isEndOfWord) {
+                        slot.info |= kEndOfWordBit;
+                        slot.info |= static_cast<uint32_t>(childNode->boundary) << kBoundaryShift;
+                        trie.hasBoundaries = trie.hasBoundaries || childNode->boundary != BoundaryMode::Substring;
+                        if (childNode->isAllowed) {
+                            slot.info |= kAllowedBit;
+                            trie.hasAllowlist = true;
+                        }
+                        slot.pattern = childNode->patternId;
+                        trie.maxWordLength = std::max<size_t>(trie.maxWordLength, slot.info & kDepthMask);
+                    }
+                    queue.push_back({childNode, next});
+                    edges.emplace_back(next, state, c);
+                }
+            }
+
+            trie.usedStates = queue.size();
+            slots.resize(maxUsedSlot + kAlphabetSize + 1);
+            slots.shrink_to_fit();
+            trie.table = slots.data();
+            trie.tableSize = slots.size();
+            linkFailures(edges);
+            // 移动 vector 不会改变缓冲区地址，table 保持有效
+            trie.storage = std::make_shared<const std::vector<Slot>>(std::move(slots));
+            trie.updateWindow();
+            trie.buildPrefilter();
+        }
+
+    private:
+        CompiledTrie& trie;
+        static constexpr size_t kMaxAttempts = 16;
+
+        std::vector<Slot> slots;
+        size_t maxUsedSlot = 0;
+        size_t searchFrom = 0;
+        // nextFree[i] 指向下标不小于 i 的某个空闲位置（带路径压缩的并查集）
+        std::vector<int32_t> nextFree;
+
+        bool isFree(size_t pos) const {
+            return slots[pos].check == kNoState;
+        }
+
+        void ensureSize(size_t size) {
+            if (nextFree.size() < size) {
+                size_t oldSize = nextFree.size();
+                slots.resize(std::max(size, slots.size() * 2));
+                nextFree.resize(slots.size());
+                for (size_t i = oldSize; i < nextFree.size(); ++i) {
+                    nextFree[i] = static_cast<int32_t>(i);
+                }
+            }
+        }
+
+        size_t findFree(size_t pos) {
+            ensureSize(pos + kAlphabetSize + 1);
+            size_t free = pos;
+            while (static_cast<size_t>(nextFree[free]) != free) {
+                free = nextFree[free];
+                ensureSize(free + kAlphabetSize + 1);
+            }
+            while (pos != free) {
+                size_t next = nextFree[pos];
+                nextFree[pos] = static_cast<int32_t>(free);
+                pos = next;
+            }
+            return free;
+        }
+
+        void occupy(size_t pos, int32_t parent) {
+            slots[pos].check = parent;
+            nextFree[pos] = static_cast<int32_t>(pos + 1);
+            maxUsedSlot = std::max(maxUsedSlot, pos);
+        }
+
+        int32_t findBase(const std::vector<std::pair<unsigned char, const TrieNode*>>& children) {
+            const unsigned char first = children.front().first;
+            // 只有一个子节点时第一个空闲位置一定可用；多个子节点时跳过已经很拥挤的区域
+            const bool single = children.size() == 1;
+            size_t pos = findFree(std::max<size_t>(single ? 0 : searchFrom, first + 1u));
+            size_t attempts = 0;
+
+            while (true) {
+                size_t base = pos - first;
+                ensureSize(base + kAlphabetSize + 1);
+                bool fits = true;
+                for (const auto& entry : children) {
+                    if (!isFree(base + entry.first)) {
+                        fits = false;
+                        break;
+                    }
+                }
+                if (fits) {
+                    if (!single && attempts > kMaxAttempts) {
+                        searchFrom = pos;
+                    }
+                    return static_cast<int32_t>(base);
+                }
+                pos = findFree(pos + 1);
+                ++attempts;
+            }
+        }
+
+        void linkFailures(const std::vector<std::tuple<int32_t, int32_t, unsigned char>>& edges) {
+            for (const auto& [next, parent, c] : edges) {
+                int32_t fail = kRootState;
+                if (parent != kRootState) {
+                    fail = slots[parent].fail;
+                    while (fail != kRootState && trie.child(fail, c) == kNoState) {
+                        fail = slots[fail].fail;
+                    }
+                    int32_t target = trie.child(fail, c);
+                    if (target != kNoState) {
+                        fail = target;
+                    }
+                }
+
+                Slot& slot = slots[next];
+                slot.fail = fail;
+                slot.output = trie.isEndOfWord(fail) ? fail : slots[fail].output;
+            }
+        }
+    };
+};
+
+/**
+ * @brief 流式屏蔽 - 分段输入文本，按顺序输出屏蔽后的文本
+ *
+ * 自动机状态和待定的匹配在各段之间保留，跨段的脏话同样会被屏蔽，输出与对整个文本
+ * 调用 censor 相同。内部最多缓存当前段加上不超过最长词长度的待定字节
+ * （混淆归一化模式下为 CompiledTrie::normalizedSpanLimit() 个字节），内存占用与文本总长度无关。使用期间不要修改 trie 所属过滤器的词表。
+ */
+class StreamingCensor {
+public:
+    /**
+     * @param utf8 是否按 UTF-8 做大小写折叠（见 TrieFilter::setUtf8Mode），
+     *             此时段尾不完整的多字节字符会留到下一段一起扫描
+     * @param normalizer 不为空时做混淆归一化（见 TrieFilter::setObfuscationNormalizer），
+     *                   使用期间必须保持有效
+     */
+    StreamingCensor(const CompiledTrie& trie, char replacementChar, bool utf8 = false,
+                    const ObfuscationNormalizer* normalizer = nullptr)
+        : trie(trie), replacementChar(replacementChar), utf8(utf8), normalizer(normalizer),
+          longest(trie.windowSize()), offsets(normalizer ? 2 * longest.size() : 0) {}
+
+    /**
+     * @brief 输入一段文本，把已经确定的输出交给 sink
+     * @param sink 回调 sink(std::string_view)，按顺序收到屏蔽后的文本
+     */
+    template <typename Sink>
+    void feed(std::string_view chunk, Sink&& sink) {
+        pending.append(chunk.data(), chunk.size());
+        scanPending(false);
+        flushSettled(sink);
+    }
+
+    /**
+     * @brief 文本结束，输出剩余的字节并重置状态，之后可以开始新的文本
+     */
+    template <typename Sink>
+    void finish(Sink&& sink) {
+        scanPending(true);
+        auto onMatch = [&](size_t start, size_t length, uint32_t) { mask(start, length); };
+        if (normalizer) {
+            trie.finishNormalized(normalized, window(), onMatch);
+            sink(std::string_view(pending));
+            pending.clear();
+        } else {
+            trie.finishScan(pendingBase + pending.size(), scan, longest.data(), onMatch);
+            flushSettled(sink);
+        }
+        scan = CompiledTrie::ScanState();
+        pendingBase = 0;
+        scanned = 0;
+    }
+
+    /**
+     * @brief 已输入但尚未输出的字节数
+     */
+    size_t pendingBytes() const {
+        return pending.size();
+    }
+
+private:
+    const CompiledTrie& trie;
+    char replacementChar;
+    bool utf8;
+    const ObfuscationNormalizer* normalizer;
+    std::vector<CompiledTrie::Candidate> longest;
+    std::vector<size_t> offsets; // 归一化模式下位置到原文偏移的映射
+    CompiledTrie::ScanState scan;
+    CompiledTrie::NormalizedScanState normalized;
+    std::string pending;    // 尚未输出的字节
+    size_t pendingBase = 0; // pending[0] 在整个文本中的偏移
+    size_t scanned = 0;     // 已扫描的字节数（整个文本中的偏移）
+    std::string folded;     // UTF-8 模式下折叠后的待扫描字节
+
+    /**
+     * @brief 扫描 pending 中尚未扫描的部分
+     */
+    void scanPending(bool last) {
+        std::string_view rest = std::string_view(pending).substr(scanned - pendingBase);
+        if (rest.empty()) {
+            return;
+        }
+        auto onMatch = [&](size_t start, size_t length, uint32_t) { mask(start, length); };
+        const size_t available = rest.size();
+        size_t done = available;
+        if (utf8) {
+            folded.resize(rest.size());
+            done = Utf8CaseFolder::fold(rest.data(), rest.size(), folded.data(), last);
+            rest = std::string_view(folded.data(), done);
+        }
+        if (normalizer) {
+            trie.scanNormalizedChunk<false>(rest, scanned, *normalizer, normalized, window(), onMatch);
+        } else {
+            trie.scanChunk(rest, scanned, last && done == available, scan, longest.data(), onMatch);
+        }
+        scanned += done;
+    }
+
+    CompiledTrie::NormalizedWindow window() {
+        return {longest.data(), offsets.data(), offsets.data() + longest.size()};
+    }
+
+    /**
+     * @brief 已经确定的原文偏移
+     *
+     * 归一化模式下，所有位置都已确定时没有匹配会延伸到已扫描的字节之后，
+     * 否则第一个待定位置对应的原文字节之前都已确定。
+     */
+    size_t settledOffset() const {
+        if (!normalizer) {
+            return scan.next;
+        }
+        if (normalized.scan.next == normalized.position) {
+            return scanned;
+        }
+        return offsets[normalized.scan.next & (longest.size() - 1)];
+    }
+
+    void mask(size_t start, size_t length) {
+        for (size_t k = 0; k < length; ++k) {
+            pending[start - pendingBase + k] = replacementChar;
+        }
+    }
+
+    template <typename Sink>
+    void flushSettled(Sink& sink) {
+        size_t offset = settledOffset();
+        size_t settled = offset - pendingBase;
+        if (settled == 0) {
+            return;
+        }
+        sink(std::string_view(pending.data(), settled));
+        pending.erase(0, settled);
+        pendingBase = offset;
+    }
+};
+
+/**
+ * @brief 增量扫描会话 - 用于实时文本流（如语音转文字、socket 消息）
+ *
+ * 每次 feed 一个片段，立即返回已经可以确定的屏蔽结果。可能是某个脏话开头的字节
+ * 会暂时保留，保留的字节数不超过 maxHoldBack()；历史文本不会被重新扫描。
+ * 所有片段结束后调用 finish 取回剩余的字节。使用期间不要修改创建会话的过滤器的词表。
+ */
+class ScanSession {
+public:
+    ScanSession(const CompiledTrie& trie, char replacementChar, bool utf8 = false,
+                const ObfuscationNormalizer* normalizer = nullptr)
+        : trie(&trie), utf8(utf8), normalized(normalizer != nullptr),
+          stream(trie, replacementChar, utf8, normalizer) {}
+
+    /**
+     * @brief 输入一个片段，把可以输出的屏蔽结果追加到 out
+     */
+    void feed(std::string_view fragment, std::string& out) {
+        stream.feed(fragment, [&](std::string_view text) { out.append(text.data(), text.size()); });
+    }
+
+    std::string feed(std::string_view fragment) {
+        std::string out;
+        feed(fragment, out);
+        return out;
+    }
+
+    /**
+     * @brief 文本流结束，把剩余的字节追加到 out；之后会话可以用于新的文本流
+     */
+    void finish(std::string& out) {
+        stream.finish([&](std::string_view text) { out.append(text.data(), text.size()); });
+    }
+
+    std::string finish() {
+        std::string out;
+        finish(out);
+        return out;
+    }
+
+    /**
+     * @brief 当前保留、尚未输出的字节数
+     */
+    size_t pendingBytes() const {
+        return stream.pendingBytes();
+    }
+
+    /**
+     * @brief 保留字节数的上限：最长脏话的长度，UTF-8 模式下再加上一个不完整字符的最多 3 个字节
+     *
+     * 有白名单时匹配要等到重叠的白名单短语读完，上限为最长词长度的两倍。
+     * 混淆归一化模式下还可以夹杂分隔符和被折叠的重复字母，上限为 CompiledTrie::normalizedSpanLimit()。
+     */
+    size_t maxHoldBack() const {
+        const size_t longest = std::max<size_t>(trie->longestWordLength(), 1);
+        const size_t held = normalized ? trie->normalizedSpanLimit() : trie->hasAllowRules() ? 2 * longest : longest;
+        return held + (utf8 ? 3 : 0);
+    }
+
+private:
+    const CompiledTrie* trie;
+    bool utf8;
+    bool normalized;
+    StreamingCensor stream;
+};
+
+/**
+ * @brief 简单替换法 - 每个脏话独立查找和替换
+ * 
+ * 每个脏话各自在原文中从左到右查找不重叠的出现，不同脏话的出现可以相互重叠，
+ * 结果与逐个调用 find 相同。所有脏话在第一次查询前编译进同一个 CompiledTrie，
+ * 一次扫描得到所有脏话的出现，检测时遇到第一个匹配即返回，耗时与词表大小无关。
+ * 
+ * 优点：语义简单直接，每个脏话的出现都会被屏蔽
+ * 缺点：无法处理变体
+ */
+class SimpleReplacementFilter : public ProfanityFilter {
+private:
+    struct Entry {
+        uint32_t id; // 按添加顺序分配的编号
+        BoundaryMode boundary;
+    };
+
+    // 脏话 -> 编号和边界要求
+    std::map<std::string, Entry> profanityList;
+    std::vector<BoundaryMode> boundaries; // 按编号索引
+    bool hasBoundaryRules = false;
+    std::vector<std::string> allowedPhrases; // 已转为小写
+    char replacementChar;
+
+    // 所有脏话编译成的自动机，在词表变化后的第一次查询前构建一次
+    mutable CompiledTrie compiled;
+    mutable std::atomic<bool> compiledReady{false};
+    mutable std::mutex compileMutex;
+    
+public:
+    explicit SimpleReplacementFilter(char replacementChar = '*') 
+        : replacementChar(replacementChar) {
+        // 默认脏话列表
+        for (const char* word : {"shit", "fuck", "damn", "ass", "bitch", "bastard"}) {
+            addProfanity(word);
+        }
+    }
+    
+    using ProfanityFilter::containsProfanity;
+    
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        ensureCompiled();
+        if (compiled.prefilter().nextCandidate(text.data(), text.size(), 0) == text.size()) {
+            scope.prefilterRejected();
+            return false;
+        }
+        
+        if (!allowedPhrases.empty()) {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            findMatches(text, matches);
+            return !matches.empty();
+        }
+        if (!hasBoundaryRules) {
+            return compiled.containsMatch(text);
+        }
+        return !compiled.forEachOccurrence(text, [&](size_t start, size_t length, uint32_t id) {
+            return !matchesBoundary(text, start, length, boundaries[id]);
+        });
+    }
+    
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        // 先在原文上找出所有位置再统一替换，避免已替换的字符影响后续词的查找
+        ScratchMatches scratch;
+        std::vector<Match>& matches = scratch.get();
+        findMatches(std::string_view(buf, len), matches);
+        applyMatches(buf, len, matches, replacementChar);
+    }
+    
+    /**
+     * @brief 匹配按结束位置排列
+     */
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        ensureCompiled();
+        if (compiled.prefilter().nextCandidate(text.data(), text.size(), 0) == text.size()) {
+            scope.prefilterRejected();
+            return;
+        }
+        
+        size_t first = matches.size();
+        compiled.forEachOccurrence(text, [&](size_t start, size_t length, uint32_t id) {
+            if (!matchesBoundary(text, start, length, boundaries[id])) {
+                return true;
+            }
+            // 同一个词的出现不重叠：与之重叠的已有匹配都在末尾，且结束位置大于 start
+            for (size_t k = matches.size(); k > first && matches[k - 1].offset + matches[k - 1].length > start; --k) {
+                if (matches[k - 1].patternId == id) {
+                    return true;
+                }
+            }
+            matches.push_back({start, length, id});
+            return true;
+        });
+        removeAllowed(text, matches, first, allowedPhrases);
+        scope.matches(matches.data() + first, matches.data() + matches.size());
+    }
+    
+    void addProfanity(const std::string& word) override {
+        addProfanity(word, BoundaryMode::Substring);
+    }
+
+    /**
+     * @brief 同一个词再次添加时保留编号，边界要求以最后一次为准
+     */
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        auto [it, added] = profanityList.emplace(toLower(word), Entry{static_cast<uint32_t>(profanityList.size()), boundary});
+        it->second.boundary = boundary;
+        if (added) {
+            boundaries.push_back(boundary);
+            compiledReady.store(false, std::memory_order_release);
+        } else {
+            boundaries[it->second.id] = boundary;
+        }
+        hasBoundaryRules |= boundary != BoundaryMode::Substring;
+    }
+
+    /**
+     * @brief 命中后只在其附近查找白名单短语
+     */
+    void addAllowedPhrase(const std::string& phrase) override {
+        if (!phrase.empty()) {
+            allowedPhrases.push_back(toLower(phrase));
+        }
+    }
+    
+    void loadFromFile(const std::string& filename) override {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return;
+        }
+        
+        std::string word;
+        while (std::getline(file, word)) {
+            if (!word.empty()) {
+                addProfanity(word);
+            }
+        }
+        file.close();
+    }
+
+    void compile() override {
+        ensureCompiled();
+    }
+    
+private:
+    /**
+     * @brief 词表变化后重新编译；多个线程同时查询时只有一个线程负责编译
+     *
+     * 边界要求由 findMatches 按原来的规则检查，自动机中的词都不带边界要求。
+     */
+    void ensureCompiled() const {
+        if (compiledReady.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(compileMutex);
+        if (compiledReady.load(std::memory_order_relaxed)) {
+            return;
+        }
+        TrieArena arena;
+        for (const auto& [word, entry] : profanityList) {
+            if (word.empty()) {
+                continue; // 空串在任何文本中都不算出现
+            }
+            TrieNode* node = arena.root();
+            for (char c : word) {
+                TrieNode*& child = node->children[c];
+                if (child == nullptr) {
+                    child = arena.newNode();
+                }
+                node = child;
+            }
+            node->isEndOfWord = true;
+            node->patternId = entry.id;
+        }
+        compiled = CompiledTrie::compile(*arena.root());
+        compiledReady.store(true, std::memory_order_release);
+    }
+
+    static std::string toLower(const std::string& str) {
+        std::string lower = str;
+        for (char& c : lower) {
+            c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+        }
+        return lower;
+    }
+};
+
+/**
+ * @brief 分块布隆过滤器 - 每个元素的所有位都落在同一个 64 字节的块内
+ *
+ * 查询只访问一个缓存行。每个元素约占 10 位，误判率约 1%，不会漏判。
+ */
+class BlockedBloomFilter {
+public:
+    static constexpr size_t kBitsPerItem = 10;
+
+    /**
+     * @brief 按预计的元素个数分配空间，清空已有内容
+     */
+    void reset(size_t items) {
+        size_t blocks = std::max<size_t>(1, (items * kBitsPerItem + kBlockBits - 1) / kBlockBits);
+        bits.assign(blocks * kWordsPerBlock, 0);
+    }
+
+    void insert(uint64_t hash) {
+        uint64_t* block = blockFor(hash);
+        uint64_t probe = mixHash(hash, kProbeSeed);
+        for (unsigned i = 0; i < kProbes; ++i, probe >>= 9) {
+            block[(probe >> 6) & 7] |= uint64_t(1) << (probe & 63);
+        }
+    }
+
+    bool mayContain(uint64_t hash) const {
+        if (bits.empty()) {
+            return false;
+        }
+        const uint64_t* block = blockFor(hash);
+        uint64_t probe = mixHash(hash, kProbeSeed);
+        for (unsigned i = 0; i < kProbes; ++i, probe >>= 9) {
+            if (!((block[(probe >> 6) & 7] >> (probe & 63)) & 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 提前把 hash 所在的块读入缓存，连续查询多个元素时先逐个预取再逐个查询
+     */
+    void prefetch([[maybe_unused]] uint64_t hash) const {
+#if defined(__GNUC__) || defined(__clang__)
+        if (!bits.empty()) {
+            __builtin_prefetch(blockFor(hash));
+        }
+#endif
+    }
+
+    size_t memoryUsage() const {
+        return bits.size() * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr size_t kWordsPerBlock = 8;
+    static constexpr size_t kBlockBits = kWordsPerBlock * 64;
+    static constexpr unsigned kProbes = 7; // 每次用 9 位选块内的一位，共 63 位
+    static constexpr uint64_t kProbeSeed = 0x589965cc75374cc3ull;
+
+    std::vector<uint64_t> bits;
+
+    uint64_t* blockFor(uint64_t hash) {
+        return bits.data() + blockIndex(hash) * kWordsPerBlock;
+    }
+
+    const uint64_t* blockFor(uint64_t hash) const {
+        return bits.data() + blockIndex(hash) * kWordsPerBlock;
+    }
+
+    size_t blockIndex(uint64_t hash) const {
+        // 高 32 位乘以块数后取高位，映射到 [0, 块数)，不需要除法
+        size_t blocks = bits.size() / kWordsPerBlock;
+        return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(blocks)) >> 32);
+    }
+};
+
+/**
+ * @brief 分词查表过滤器 - 为百万级的大词表设计，正文只分词一次，每个单词查一次表
+ *
+ * 正文按单词字符（见 isWordByte）切分，每个单词先查布隆过滤器（每个词约 1.25 字节），
+ * 可能命中时再到紧凑的哈希表中精确确认。词表中的词连续存放在一个字符串中，
+ * 哈希表只保存下标，不为每个词单独分配字符串。只匹配整个单词，相当于 BoundaryMode::WholeWord；
+ * 含有非单词字符的词（如 "f*ck"、多个单词的短语）不能作为单个单词出现，添加时输出错误信息。
+ * 大小写折叠只处理 ASCII 字母。
+ *
+ * 优点：内存占用小，查询次数只与单词数有关，与词表大小无关
+ * 缺点：不能匹配单词的一部分（如 "motherfucker" 中的 "fuck"）
+ */
+class TokenFilter : public ProfanityFilter {
+public:
+    explicit TokenFilter(char replacementChar = '*', bool defaultWords = true) : replacementChar(replacementChar) {
+        if (defaultWords) {
+            for (const char* word : {"shit", "fuck", "damn", "ass", "bitch", "bastard"}) {
+                addProfanity(word);
+            }
+        }
+    }
+
+    using ProfanityFilter::containsProfanity;
+
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        if (!allowedPhrases.empty()) {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            findMatches(text, matches);
+            return !matches.empty();
+        }
+        ensureCompiled();
+        return !forEachToken(text, [](size_t, size_t, uint32_t) { return false; });
+    }
+
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        if (!allowedPhrases.empty()) {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            findMatches(std::string_view(buf, len), matches);
+            applyMatches(buf, len, matches, replacementChar);
+            return;
+        }
+        ensureCompiled();
+        forEachToken(std::string_view(buf, len), [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            std::memset(buf + start, replacementChar, length);
+            return true;
+        });
+    }
+
+    void censorMask(std::string_view text, std::vector<uint64_t>& mask) const override {
+        auto scope = recordCall(MetricsOperation::Censor, text.size());
+        mask.assign(maskWords(text.size()), 0);
+        if (!allowedPhrases.empty()) {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            findMatches(text, matches);
+            for (const Match& match : matches) {
+                markMask(mask, match.offset, match.length);
+            }
+            return;
+        }
+        ensureCompiled();
+        forEachToken(text, [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            markMask(mask, start, length);
+            return true;
+        });
+    }
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        ensureCompiled();
+        size_t first = matches.size();
+        forEachToken(text, [&](size_t start, size_t length, uint32_t patternId) {
+            matches.push_back({start, length, patternId});
+            return true;
+        });
+        removeAllowed(text, matches, first, allowedPhrases);
+        scope.matches(matches.data() + first, matches.data() + matches.size());
+    }
+
+    void addProfanity(const std::string& word) override {
+        addProfanity(word, BoundaryMode::WholeWord);
+    }
+
+    /**
+     * @brief 总是按整个单词匹配，boundary 不起作用
+     */
+    void addProfanity(const std::string& word, BoundaryMode) override {
+        if (word.empty()) {
+            return;
+        }
+        if (word.size() > kMaxTokenLength ||
+            !std::all_of(word.begin(), word.end(), [](char c) { return isWordByte(static_cast<unsigned char>(c)); })) {
+            std::cerr << "TokenFilter 只能匹配不超过 " << kMaxTokenLength << " 字节的单个单词，忽略: " << word
+                      << std::endl;
+            return;
+        }
+        std::string folded = word;
+        for (char& c : folded) {
+            c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+        }
+        if (find(folded.data(), folded.size(), hashBytes(folded.data(), folded.size())) != kNoWord) {
+            return;
+        }
+        if (2 * (entries.size() + 1) > slots.size()) {
+            rehash(std::max<size_t>(kInitialSlots, 2 * slots.size()));
+        }
+        entries.push_back({static_cast<uint32_t>(storage.size()), static_cast<uint32_t>(folded.size())});
+        storage += folded;
+        insertSlot(static_cast<uint32_t>(entries.size() - 1));
+        minLength = std::min(minLength, folded.size());
+        maxLength = std::max(maxLength, folded.size());
+        compiledReady.store(false, std::memory_order_release);
+    }
+
+    /**
+     * @brief 与白名单短语的某次出现重叠的单词不屏蔽
+     */
+    void addAllowedPhrase(const std::string& phrase) override {
+        if (!phrase.empty()) {
+            std::string lower = phrase;
+            for (char& c : lower) {
+                c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+            }
+            allowedPhrases.push_back(std::move(lower));
+        }
+    }
+
+    void loadFromFile(const std::string& filename) override {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return;
+        }
+
+        std::string word;
+        while (std::getline(file, word)) {
+            if (!word.empty()) {
+                addProfanity(word);
+            }
+        }
+    }
+
+    void compile() override {
+        ensureCompiled();
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    /**
+     * @brief 布隆过滤器占用的字节数
+     */
+    size_t gateMemoryUsage() const {
+        ensureCompiled();
+        return gate.memoryUsage();
+    }
+
+    /**
+     * @brief 布隆过滤器和精确词表一共占用的字节数
+     */
+    size_t memoryUsage() const {
+        return gateMemoryUsage() + storage.capacity() + entries.capacity() * sizeof(Entry) +
+               slots.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    static constexpr uint32_t kNoWord = UINT32_MAX;
+    static constexpr size_t kInitialSlots = 64;
+    static constexpr size_t kMaxTokenLength = 256; // 更长的单词不查表，也不接受为脏话
+    static constexpr size_t kProbeBatch = 16;
+
+    // storage 中 [offset, offset + length) 是一个已转为小写的词，编号即在 entries 中的下标
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::string storage;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> slots; // 开放寻址的哈希表，保存 entries 的下标加一，0 表示空位
+    size_t minLength = SIZE_MAX;
+    size_t maxLength = 0;
+    std::vector<std::string> allowedPhrases; // 已转为小写
+    char replacementChar;
+
+    // 布隆过滤器按词数分配，在词表变化后的第一次查询前重建
+    mutable BlockedBloomFilter gate;
+    mutable std::atomic<bool> compiledReady{false};
+    mutable std::mutex compileMutex;
+
+    /**
+     * @brief 对每个在词表中的单词调用 visit(start, length, patternId)，visit 返回 false 时停止
+     *
+     * 单词按 kProbeBatch 个一组：先算出哈希并预取布隆过滤器的块，再逐个查询，
+     * 大词表的布隆过滤器不在缓存中时，各次内存访问可以重叠。
+     * @return 是否处理完了整个文本
+     */
+    template <typename Visit>
+    bool forEachToken(std::string_view text, Visit&& visit) const {
+        struct Token {
+            size_t start;
+            size_t length;
+            uint64_t hash;
+        };
+        Token batch[kProbeBatch];
+        char folded[kMaxTokenLength];
+        size_t i = 0;
+        while (i < text.size()) {
+            size_t count = 0;
+            while (count < kProbeBatch && i < text.size()) {
+                while (i < text.size() && !isWordByte(static_cast<unsigned char>(text[i]))) {
+                    ++i;
+                }
+                size_t start = i;
+                while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) {
+                    ++i;
+                }
+                size_t length = i - start;
+                if (length < minLength || length > maxLength) {
+                    continue; // 长度不在词表的范围内，不需要计算哈希
+                }
+                for (size_t k = 0; k < length; ++k) {
+                    folded[k] = static_cast<char>(foldCase(static_cast<unsigned char>(text[start + k])));
+                }
+                uint64_t hash = hashBytes(folded, length);
+                gate.prefetch(hash);
+                batch[count++] = {start, length, hash};
+            }
+            for (size_t b = 0; b < count; ++b) {
+                const Token& token = batch[b];
+                if (!gate.mayContain(token.hash)) {
+                    continue;
+                }
+                for (size_t k = 0; k < token.length; ++k) {
+                    folded[k] = static_cast<char>(foldCase(static_cast<unsigned char>(text[token.start + k])));
+                }
+                uint32_t id = find(folded, token.length, token.hash);
+                if (id != kNoWord && !visit(token.start, token.length, id)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    uint32_t find(const char* word, size_t length, uint64_t hash) const {
+        if (slots.empty()) {
+            return kNoWord;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint32_t index = slots[slot];
+            if (index == 0) {
+                return kNoWord;
+            }
+            const Entry& entry = entries[index - 1];
+            if (entry.length == length && std::memcmp(storage.data() + entry.offset, word, length) == 0) {
+                return index - 1;
+            }
+        }
+    }
+
+    void insertSlot(uint32_t id) {
+        const Entry& entry = entries[id];
+        size_t mask = slots.size() - 1;
+        size_t slot = hashBytes(storage.data() + entry.offset, entry.length) & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id + 1;
+    }
+
+    void rehash(size_t size) {
+        slots.assign(size, 0);
+        for (uint32_t id = 0; id < entries.size(); ++id) {
+            insertSlot(id);
+        }
+    }
+
+    void ensureCompiled() const {
+        if (compiledReady.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(compileMutex);
+        if (compiledReady.load(std::memory_order_relaxed)) {
+            return;
+        }
+        gate.reset(entries.size());
+        for (const Entry& entry : entries) {
+            gate.insert(hashBytes(storage.data() + entry.offset, entry.length));
+        }
+        compiledReady.store(true, std::memory_order_release);
+    }
+};
+
+/**
+ * @brief 字典树法 - 使用字典树高效检测脏话
+ * 
+ * 可变的 TrieNode 树只在添加脏话时使用，查询前会编译为 CompiledTrie。
+ * 调用 compile() 后可变树被释放，只保留紧凑的双数组；之后再添加脏话时自动还原。
+ * 
+ * 优点：查找效率高，适合大规模脏话列表
+ * 缺点：实现较复杂，修改词表后需要重新编译
+ */
+class TrieFilter : public ProfanityFilter {
+protected:
+    // 可变字典树，编译后可以释放；节点的内存来自 upstream
+    std::unique_ptr<TrieArena> trie;
+    std::pmr::memory_resource* upstream;
+    char replacementChar;
+    uint32_t patternCount = 0;
+    bool utf8Mode = false;
+    std::optional<ObfuscationNormalizer> normalizer;
+
+    // 编译后的双数组，在词表变化后的第一次查询前构建一次
+    mutable CompiledTrie compiled;
+    mutable std::atomic<bool> compiledReady{false};
+    mutable std::mutex compileMutex;
+
+    // 按脏话编号索引的类别和严重程度；没有记录的编号使用默认的 WordTag
+    std::vector<WordTag> tags;
+    Severity highestSeverity = Severity::Medium; // 词表中可能出现的最高严重程度
+    
+public:
+    /**
+     * @param replacementChar 替换字符
+     * @param upstream 可变字典树申请内存块的来源，如 std::pmr::unsynchronized_pool_resource
+     * @param defaultWords 为 false 时不加载默认词表，如只保存少量附加词的租户词表
+     */
+    explicit TrieFilter(char replacementChar = '*',
+                        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+                        bool defaultWords = true) 
+        : trie(std::make_unique<TrieArena>(upstream)), upstream(upstream), replacementChar(replacementChar) {
+        if (!defaultWords) {
+            return;
+        }
+        // 默认脏话列表
+        std::vector<std::string> defaultList = {
+            "shit", "fuck", "damn", "ass", "bitch", "bastard"
+        };
+        
+        for (const auto& word : defaultList) {
+            addToTrie(word);
+        }
+    }
+    
+    using ProfanityFilter::containsProfanity;
+    
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        ensureCompiled();
+        if (normalizer) {
+            return compiled.containsNormalized(text, *normalizer, utf8Mode);
+        }
+        if (utf8Mode) {
+            return compiled.containsMatchUtf8(text);
+        }
+        if (compiled.hasAllowRules()) {
+            return compiled.containsMatch(text);
+        }
+        const FirstBytePrefilter& prefilter = compiled.prefilter();
+        size_t first = prefilter.nextCandidate(text.data(), text.length(), 0);
+        if (first == text.length()) {
+            scope.prefilterRejected();
+            return false;
+        }
+        
+        for (size_t i = first; i < text.length(); ++i) {
+            i = prefilter.nextCandidate(text.data(), text.length(), i);
+            if (i == text.length()) {
+                break;
+            }
+            int32_t state = CompiledTrie::kRootState;
+            for (size_t j = i; j < text.length(); ++j) {
+                state = compiled.child(state, foldCase(static_cast<unsigned char>(text[j])));
+                if (state == CompiledTrie::kNoState) {
+                    break;
+                }
+                
+                if (compiled.isEndOfWord(state) && matchesBoundary(text, i, j - i + 1, compiled.boundary(state))) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        ensureCompiled();
+        scanLongest(std::string_view(buf, len), [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            // 替换脏话为指定字符
+            for (size_t k = 0; k < length; ++k) {
+                buf[start + k] = replacementChar;
+            }
+        });
+    }
+
+    void censorMask(std::string_view text, std::vector<uint64_t>& mask) const override {
+        auto scope = recordCall(MetricsOperation::Censor, text.size());
+        ensureCompiled();
+        mask.assign(maskWords(text.size()), 0);
+        scanLongest(text, [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            markMask(mask, start, length);
+        });
+    }
+    
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        ensureCompiled();
+        scanLongest(text, [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            matches.push_back({start, length, patternId});
+        });
+    }
+    
+    void addProfanity(const std::string& word) override {
+        addToTrie(normalizeWord(word));
+    }
+
+    /**
+     * @brief 边界要求记录在词尾状态中，扫描时随输出一起检查；再次添加同一个词时更新要求
+     */
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        addToTrie(normalizeWord(word), boundary);
+    }
+
+    /**
+     * @brief 添加脏话并指定类别和严重程度；再次添加同一个词时更新
+     */
+    void addProfanity(const std::string& word, WordTag tag, BoundaryMode boundary = BoundaryMode::Substring) {
+        std::optional<uint32_t> id = addToTrie(normalizeWord(word), boundary);
+        if (!id) {
+            return;
+        }
+        if (tags.size() <= *id) {
+            tags.resize(*id + 1);
+        }
+        tags[*id] = tag;
+        highestSeverity = std::max(highestSeverity, tag.severity);
+    }
+
+    /**
+     * @brief 脏话编号对应的类别和严重程度
+     */
+    WordTag tagOf(uint32_t patternId) const {
+        return patternId < tags.size() ? tags[patternId] : WordTag();
+    }
+
+    /**
+     * @brief 按屏蔽时的匹配结果分级，找到词表中可能出现的最高严重程度（如 Block）后立即停止扫描
+     */
+    Classification classify(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        ensureCompiled();
+        Classification result;
+        compiled.scanLongestUntil(text, utf8Mode, normalizer ? &*normalizer : nullptr,
+                                  [&](size_t start, size_t length, uint32_t patternId) {
+                                      scope.match(patternId);
+                                      WordTag tag = tagOf(patternId);
+                                      if (tag.severity > result.severity) {
+                                          result.severity = tag.severity;
+                                          result.category = tag.category;
+                                          result.match = {start, length, patternId};
+                                      }
+                                      return result.severity < highestSeverity;
+                                  });
+        return result;
+    }
+
+    /**
+     * @brief 白名单短语与脏话编译进同一个自动机，扫描时取消与之重叠的匹配，不需要第二遍扫描
+     *
+     * 与某个脏话相同的短语会取代该脏话。
+     */
+    void addAllowedPhrase(const std::string& phrase) override {
+        addToTrie(normalizeWord(phrase), BoundaryMode::Substring, true);
+    }
+    
+    void loadFromFile(const std::string& filename) override {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return;
+        }
+        
+        std::string word;
+        while (std::getline(file, word)) {
+            if (!word.empty()) {
+                addToTrie(normalizeWord(word));
+            }
+        }
+        file.close();
+    }
+
+    /**
+     * @brief 开启或关闭 UTF-8 模式
+     *
+     * 开启后脏话和正文都按 Utf8CaseFolder 做大小写折叠，西里尔、希腊、拉丁扩展等
+     * 字母不区分大小写；中文等没有大小写的文字在两种模式下都按字节匹配。
+     * 只影响之后添加的脏话，应在加载词表前设置。
+     */
+    void setUtf8Mode(bool enabled) {
+        utf8Mode = enabled;
+    }
+
+    bool isUtf8Mode() const {
+        return utf8Mode;
+    }
+
+    /**
+     * @brief 开启或关闭混淆归一化，识别 f@ck、fuuuck、f.u.c.k 等变体
+     *
+     * 开启时已有的脏话会按新的规则重新归一化，之后添加的脏话也一样；
+     * 扫描时正文逐字节查表，屏蔽的区间对应原文中的字节，不生成归一化后的副本。
+     * 脏话中的重复字母保留，正文中多出来的重复字母在扫描时跳过，"ass" 不会匹配 "was"。
+     * @param newNormalizer std::nullopt 表示关闭；关闭后已归一化的脏话保持不变
+     */
+    void setObfuscationNormalizer(std::optional<ObfuscationNormalizer> newNormalizer) {
+        normalizer = std::move(newNormalizer);
+        if (!normalizer) {
+            return;
+        }
+        if (!trie) {
+            trie = compiled.decompile(upstream);
+        }
+
+        // 按编号顺序重新插入，归一化后重复的脏话保留较小的编号
+        std::vector<std::tuple<uint32_t, std::string, BoundaryMode, bool>> words;
+        std::string prefix;
+        collectWords(*trie->root(), prefix, words);
+        std::sort(words.begin(), words.end());
+        trie = std::make_unique<TrieArena>(upstream);
+        for (const auto& [id, word, boundary, allowed] : words) {
+            for (const std::string& variant : normalizer->variants(normalizer->normalize(word))) {
+                insertWord(variant, id, boundary, allowed);
+            }
+        }
+        compiledReady.store(false, std::memory_order_release);
+    }
+
+    const std::optional<ObfuscationNormalizer>& obfuscationNormalizer() const {
+        return normalizer;
+    }
+
+    /**
+     * @brief 编译后的自动机，需要时先编译；供 TenantFilter 等把多个自动机放在同一次扫描中
+     */
+    const CompiledTrie& compiledTrie() const {
+        ensureCompiled();
+        return compiled;
+    }
+
+    /**
+     * @brief 按编号顺序调用 visit(word, boundary, allowed)，word 是存入字典树时的形式（已折叠和归一化）
+     *
+     * 已编译并释放了可变字典树时从双数组还原，不改变过滤器的状态。
+     */
+    template <typename Visit>
+    void forEachWord(Visit&& visit) const {
+        std::vector<std::tuple<uint32_t, std::string, BoundaryMode, bool>> words;
+        std::string prefix;
+        {
+            std::lock_guard<std::mutex> lock(compileMutex);
+            if (trie) {
+                collectWords(*trie->root(), prefix, words);
+            } else {
+                collectWords(*compiled.decompile(upstream)->root(), prefix, words);
+            }
+        }
+        std::sort(words.begin(), words.end());
+        for (const auto& [id, word, boundary, allowed] : words) {
+            visit(word, boundary, allowed);
+        }
+    }
+
+    /**
+     * @brief 创建增量扫描会话，结果与对拼接后的全文调用 censor 相同
+     */
+    ScanSession startSession() const {
+        ensureCompiled();
+        return ScanSession(compiled, replacementChar, utf8Mode, normalizer ? &*normalizer : nullptr);
+    }
+
+    /**
+     * @brief 流式屏蔽：从 in 分段读取，把屏蔽结果写入 out
+     *
+     * 跨段的脏话同样会被屏蔽，结果与 censor 相同，内存占用与输入长度无关。
+     * @param chunkSize 每次读取的字节数
+     */
+    void censorStream(std::istream& in, std::ostream& out, size_t chunkSize = kStreamChunkSize) const {
+        ensureCompiled();
+        StreamingCensor stream(compiled, replacementChar, utf8Mode, normalizer ? &*normalizer : nullptr);
+        auto sink = [&](std::string_view text) { out.write(text.data(), text.size()); };
+
+        std::vector<char> buffer(std::max<size_t>(chunkSize, 1));
+        while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+            stream.feed(std::string_view(buffer.data(), static_cast<size_t>(in.gcount())), sink);
+        }
+        stream.finish(sink);
+    }
+
+    /**
+     * @brief 并行屏蔽一个长文本（如上传的文档、日志文件），结果与 censorInPlace 完全相同
+     *
+     * 见 findMatchesParallel。各块的匹配找到后也由各线程分别替换。
+     */
+    void censorParallel(char* buf, size_t len, ThreadPool& pool = ThreadPool::shared()) const {
+        std::vector<ParallelChunk> chunks = scanParallel(std::string_view(buf, len), pool);
+        if (chunks.empty()) {
+            censorInPlace(buf, len);
+            return;
+        }
+        // 各块保留的匹配互不重叠，扫描已全部结束，可以同时改写原文
+        pool.parallelFor(chunks.size(), 1, [&](size_t first, size_t last) {
+            for (size_t k = first; k < last; ++k) {
+                const ParallelChunk& chunk = chunks[k];
+                for (size_t i = chunk.keepFrom; i < chunk.keepTo; ++i) {
+                    std::memset(buf + chunk.matches[i].offset, replacementChar, chunk.matches[i].length);
+                }
+            }
+        });
+    }
+
+    std::string censorParallel(std::string_view text, ThreadPool& pool = ThreadPool::shared()) const {
+        std::string result(text);
+        censorParallel(result.data(), result.size(), pool);
+        return result;
+    }
+
+    /**
+     * @brief 把文本切成多块，由线程池同时查找匹配，结果与 findMatches 完全相同
+     *
+     * 每块的扫描窗口向前多读 2 * longestWordLength() 个字节，使单词边界和白名单与全文扫描一致，
+     * 向后多读到下一块之内。全文扫描从左到右逐个起点决定，跳过匹配内部的起点；
+     * 相邻两块的结果在两者都会停下来决定的第一个位置之后完全一致，在该位置拼接。
+     * 在重叠区内找不到这样的位置时（如 "aaaa..." 与 "aa" 这样连续重叠的匹配），改为整体扫描。
+     * 混淆归一化模式下分隔符可以任意长，无法限定重叠区，同样整体扫描。
+     * 不超过 kParallelMinChunk 两倍的文本直接在调用线程中处理。
+     */
+    void findMatchesParallel(std::string_view text, std::vector<Match>& matches,
+                             ThreadPool& pool = ThreadPool::shared()) const {
+        std::vector<ParallelChunk> chunks = scanParallel(text, pool);
+        if (chunks.empty()) {
+            findMatches(text, matches);
+            return;
+        }
+        for (const ParallelChunk& chunk : chunks) {
+            matches.insert(matches.end(), chunk.matches.begin() + chunk.keepFrom,
+                           chunk.matches.begin() + chunk.keepTo);
+        }
+    }
+
+    // 按 kCancelCheckBytes 分段送入流式扫描，每段之间检查一次 token，结果与 censor 相同
+    bool censorCancellable(std::string_view text, std::string& out, const CancellationToken& token) const override {
+        if (token.cancelled()) {
+            return false;
+        }
+        if (text.size() <= kCancelCheckBytes) {
+            censorInto(text, out);
+            return true;
+        }
+        auto scope = recordCall(MetricsOperation::Censor, text.size());
+        ensureCompiled();
+        StreamingCensor stream(compiled, replacementChar, utf8Mode, normalizer ? &*normalizer : nullptr);
+        auto sink = [&](std::string_view part) { out.append(part.data(), part.size()); };
+        out.clear();
+        out.reserve(text.size());
+        for (size_t offset = 0; offset < text.size(); offset += kCancelCheckBytes) {
+            if (token.cancelled()) {
+                return false;
+            }
+            stream.feed(text.substr(offset, kCancelCheckBytes), sink);
+        }
+        stream.finish(sink);
+        return true;
+    }
+
+    /**
+     * @brief 屏蔽整个文件，结果写入另一个文件
+     *
+     * 在支持的平台上通过 mmap 读取输入，已处理的页面随即归还，适合处理数 GB 的文件；
+     * 其他平台退回 censorStream。
+     * @return false 如果无法打开输入或输出文件
+     */
+    bool censorFile(const std::string& inputFile, const std::string& outputFile) const {
+        std::ofstream out(outputFile, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "无法打开文件: " << outputFile << std::endl;
+            return false;
+        }
+
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(inputFile.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "无法打开文件: " << inputFile << std::endl;
+            return false;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            std::cerr << "无法打开文件: " << inputFile << std::endl;
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(info.st_size);
+        void* mapped = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (mapped != MAP_FAILED) {
+            ::madvise(mapped, size, MADV_SEQUENTIAL);
+            ensureCompiled();
+            StreamingCensor stream(compiled, replacementChar, utf8Mode, normalizer ? &*normalizer : nullptr);
+            auto sink = [&](std::string_view text) { out.write(text.data(), text.size()); };
+
+            const char* data = static_cast<const char*>(mapped);
+            for (size_t offset = 0; offset < size; offset += kStreamChunkSize) {
+                size_t length = std::min(kStreamChunkSize, size - offset);
+                stream.feed(std::string_view(data + offset, length), sink);
+                // kStreamChunkSize 是页大小的整数倍，处理完的页面可以立即丢弃
+                ::madvise(const_cast<char*>(data) + offset, length, MADV_DONTNEED);
+            }
+            stream.finish(sink);
+            ::munmap(mapped, size);
+            return static_cast<bool>(out);
+        }
+#endif
+
+        std::ifstream in(inputFile, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "无法打开文件: " << inputFile << std::endl;
+            return false;
+        }
+        censorStream(in, out);
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief 把编译后的双数组保存为二进制文件，之后可以用 loadCompiled 快速加载
+     * @return false 如果文件无法写入
+     */
+    bool saveCompiled(const std::string& filename) const {
+        ensureCompiled();
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return false;
+        }
+        CompiledTrie::FileSettings settings;
+        settings.utf8Mode = utf8Mode;
+        if (normalizer) {
+            settings.normalization = normalizer->options();
+            settings.normalizerFingerprint = normalizer->fingerprint();
+        }
+        settings.tags = tags;
+        std::lock_guard<std::mutex> lock(compileMutex);
+        return compiled.save(file, patternCount, settings);
+    }
+
+    /**
+     * @brief 加载 saveCompiled 保存的文件，替换当前词表
+     *
+     * 文件通过 mmap 直接使用，不需要逐行解析和重新编译；可变字典树在之后添加脏话时才还原。
+     * 保存时的 UTF-8 模式和混淆归一化设置随文件恢复。文件中只记录归一化的开关和映射表的指纹：
+     * 用 setMapping 等自定义过映射的词典，需要先用 setObfuscationNormalizer 设置相同的归一化器。
+     * @return false 如果文件无法读取、已损坏或归一化映射对不上，此时词表和设置不变
+     */
+    bool loadCompiled(const std::string& filename) {
+        CompiledTrie loaded;
+        uint32_t loadedPatterns = 0;
+        CompiledTrie::FileSettings settings;
+        if (!CompiledTrie::load(filename, loaded, loadedPatterns, settings)) {
+            std::cerr << "无法加载编译后的词典: " << filename << std::endl;
+            return false;
+        }
+
+        std::optional<ObfuscationNormalizer> loadedNormalizer;
+        if (settings.normalization) {
+            if (normalizer && normalizer->fingerprint() == settings.normalizerFingerprint) {
+                loadedNormalizer = normalizer;
+            } else {
+                loadedNormalizer.emplace(*settings.normalization);
+                if (loadedNormalizer->fingerprint() != settings.normalizerFingerprint) {
+                    std::cerr << "编译后的词典使用了自定义的归一化映射，请先设置相同的归一化器: " << filename
+                              << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(compileMutex);
+        compiled = std::move(loaded);
+        patternCount = loadedPatterns;
+        utf8Mode = settings.utf8Mode;
+        normalizer = std::move(loadedNormalizer);
+        tags = std::move(settings.tags);
+        highestSeverity = Severity::Medium;
+        for (const WordTag& tag : tags) {
+            highestSeverity = std::max(highestSeverity, tag.severity);
+        }
+        trie.reset();
+        compiledReady.store(true, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 编译为双数组并释放可变字典树
+     *
+     * 加载完词表后调用一次，之后查询直接使用紧凑的只读结构。
+     */
+    void compile() override {
+        ensureCompiled();
+        std::lock_guard<std::mutex> lock(compileMutex);
+        trie.reset();
+    }
+    
+protected:
+    static constexpr size_t kStreamChunkSize = size_t(1) << 20;
+    static constexpr size_t kCancelCheckBytes = size_t(1) << 16;
+    static constexpr size_t kParallelMinChunk = size_t(1) << 18; // 并行扫描时每块的最小字节数
+    static constexpr size_t kParallelMergeSlack = 4096;         // 向后多读的字节数，用于寻找拼接位置
+
+    /**
+     * @brief 并行扫描的一块：matches 是窗口内的全部匹配，[keepFrom, keepTo) 是拼接后属于该块的部分
+     */
+    struct ParallelChunk {
+        size_t begin = 0;
+        size_t validEnd = 0; // 起点小于 validEnd 的决定与全文扫描相同
+        std::vector<Match> matches;
+        size_t keepFrom = 0;
+        size_t keepTo = 0;
+    };
+
+    /**
+     * @brief 并行扫描各块并求出拼接位置；不适合并行或找不到拼接位置时返回空
+     */
+    std::vector<ParallelChunk> scanParallel(std::string_view text, ThreadPool& pool) const {
+        ensureCompiled();
+        size_t chunkCount = std::min(pool.size() * 4, text.size() / kParallelMinChunk);
+        const size_t longest = std::max<size_t>(compiled.longestWordLength(), 1);
+        // 决定一个起点需要 longest 个字节向后看，白名单短语可以再向两侧延伸 longest 个字节；
+        // UTF-8 模式下从任意字节开始解码，最多 3 个字节后与全文扫描对齐
+        const size_t context = 2 * longest + 1 + (utf8Mode ? 4 : 0);
+        const size_t slack = std::max(kParallelMergeSlack, 4 * longest);
+        if (normalizer || chunkCount < 2 || 2 * (slack + context) > text.size() / chunkCount) {
+            return {};
+        }
+
+        std::vector<ParallelChunk> chunks(chunkCount);
+        for (size_t k = 0; k < chunkCount; ++k) {
+            chunks[k].begin = text.size() / chunkCount * k;
+        }
+        pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+            for (size_t k = first; k < last; ++k) {
+                ParallelChunk& chunk = chunks[k];
+                size_t end = k + 1 < chunkCount ? chunks[k + 1].begin : text.size();
+                size_t windowBegin = chunk.begin > context ? chunk.begin - context : 0;
+                size_t windowEnd = std::min(text.size(), end + slack + context);
+                chunk.validEnd = windowEnd == text.size() ? text.size() : windowEnd - context;
+                findMatches(text.substr(windowBegin, windowEnd - windowBegin), chunk.matches);
+                for (Match& match : chunk.matches) {
+                    match.offset += windowBegin;
+                }
+                chunk.keepTo = chunk.matches.size();
+            }
+        });
+
+        // 依次与上一块拼接；上一块从 keepFrom 开始的结果此时已与全文扫描一致
+        for (size_t k = 1; k < chunkCount; ++k) {
+            ParallelChunk& previous = chunks[k - 1];
+            ParallelChunk& next = chunks[k];
+            size_t position = next.begin;
+            size_t previousIndex = previous.keepFrom;
+            size_t nextIndex = 0;
+            auto endOf = [](const Match& match) { return match.offset + match.length; };
+            for (;;) {
+                while (previousIndex < previous.matches.size() && endOf(previous.matches[previousIndex]) <= position) {
+                    ++previousIndex;
+                }
+                while (nextIndex < next.matches.size() && endOf(next.matches[nextIndex]) <= position) {
+                    ++nextIndex;
+                }
+                if (previousIndex < previous.matches.size() && previous.matches[previousIndex].offset < position) {
+                    position = endOf(previous.matches[previousIndex]);
+                } else if (nextIndex < next.matches.size() && next.matches[nextIndex].offset < position) {
+                    position = endOf(next.matches[nextIndex]);
+                } else {
+                    break; // 两次扫描都在 position 处决定
+                }
+            }
+            if (position >= previous.validEnd) {
+                return {};
+            }
+            previous.keepTo = previousIndex;
+            next.keepFrom = nextIndex;
+        }
+        return chunks;
+    }
+
+    /**
+     * @param allowed 是否作为白名单短语插入；白名单短语不占用脏话编号
+     * @return 该词的编号（已存在时为原来的编号），词为空时返回 std::nullopt
+     */
+    std::optional<uint32_t> addToTrie(const std::string& word, BoundaryMode boundary = BoundaryMode::Substring,
+                                      bool allowed = false) {
+        if (!trie) {
+            trie = compiled.decompile(upstream);
+        }
+        if (word.empty()) {
+            return std::nullopt; // 归一化后可能为空，如只由分隔符组成
+        }
+
+        bool added = false;
+        uint32_t id = patternCount;
+        if (normalizer) {
+            // 通配符变体与原词共用编号
+            bool first = true;
+            for (const std::string& variant : normalizer->variants(word)) {
+                added |= insertWord(variant, patternCount, boundary, allowed, first ? &id : nullptr);
+                first = false;
+            }
+        } else {
+            added = insertWord(word, patternCount, boundary, allowed, &id);
+        }
+        if (added && !allowed) {
+            ++patternCount;
+        }
+        compiledReady.store(false, std::memory_order_release);
+        return id;
+    }
+
+    /**
+     * @brief 插入一个词，编号为 id；词已存在时只更新边界要求并返回 false
+     *
+     * 白名单标记一旦设置就保留，再次作为脏话添加不会取消它，也不会为它加上边界要求。
+     * @param storedId 不为空时写入该词实际使用的编号
+     */
+    bool insertWord(const std::string& word, uint32_t id, BoundaryMode boundary, bool allowed = false,
+                    uint32_t* storedId = nullptr) {
+        TrieNode* node = trie->root();
+        for (char c : word) {
+            TrieNode*& child = node->children[c];
+            if (child == nullptr) {
+                child = trie->newNode();
+            }
+            node = child;
+        }
+        node->isAllowed = node->isAllowed || allowed;
+        node->boundary = node->isAllowed ? BoundaryMode::Substring : boundary; // 白名单短语不要求边界
+        bool added = !node->isEndOfWord;
+        if (added) {
+            node->isEndOfWord = true;
+            node->patternId = id;
+        }
+        if (storedId != nullptr) {
+            *storedId = node->patternId;
+        }
+        return added;
+    }
+
+    static void collectWords(const TrieNode& node, std::string& prefix,
+                             std::vector<std::tuple<uint32_t, std::string, BoundaryMode, bool>>& words) {
+        if (node.isEndOfWord) {
+            words.emplace_back(node.patternId, prefix, node.boundary, node.isAllowed);
+        }
+        for (const auto& [c, child] : node.children) {
+            prefix.push_back(c);
+            collectWords(*child, prefix, words);
+            prefix.pop_back();
+        }
+    }
+
+    /**
+     * @brief 逐个起始位置沿字典树查找，输出从左到右、每个位置最长的匹配
+     */
+    template <typename Emit>
+    void scanLongest(std::string_view text, Emit&& emit) const {
+        if (normalizer) {
+            // 归一化的位置与原文不一一对应，同样改用自动机
+            compiled.scanNormalized(text, *normalizer, utf8Mode, emit);
+            return;
+        }
+        if (utf8Mode) {
+            // 逐个起点重新查找需要向后看，UTF-8 模式下改用自动机，结果相同
+            compiled.scanLongestUtf8(text, emit);
+            return;
+        }
+        if (compiled.hasAllowRules()) {
+            // 白名单短语可能从匹配之前开始，逐个起点查找看不到，改用自动机
+            compiled.scanLongest(text, emit);
+            return;
+        }
+        const FirstBytePrefilter& prefilter = compiled.prefilter();
+        // emit 可能改写上一个匹配的字节，紧跟其后的起点使用改写前记下的边界
+        size_t lastEnd = std::string::npos;
+        bool boundaryAfterLast = false;
+        
+        for (size_t i = 0; i < text.length(); ++i) {
+            i = prefilter.nextCandidate(text.data(), text.length(), i);
+            if (i == text.length()) {
+                break;
+            }
+            bool boundaryBefore = i == 0 || (i - 1 == lastEnd ? boundaryAfterLast
+                                                              : !isWordByte(static_cast<unsigned char>(text[i - 1])));
+            int32_t state = CompiledTrie::kRootState;
+            size_t wordEnd = std::string::npos;
+            size_t wordLength = 0;
+            uint32_t wordId = 0;
+            
+            for (size_t j = i; j < text.length(); ++j) {
+                state = compiled.child(state, foldCase(static_cast<unsigned char>(text[j])));
+                if (state == CompiledTrie::kNoState) {
+                    break;
+                }
+                
+                if (compiled.isEndOfWord(state) &&
+                    matchesBoundary(boundaryBefore, text, j + 1, compiled.boundary(state))) {
+                    wordEnd = j;
+                    wordLength = j - i + 1;
+                    wordId = compiled.patternId(state);
+                }
+            }
+            
+            if (wordEnd != std::string::npos) {
+                lastEnd = wordEnd;
+                boundaryAfterLast = !isWordByte(static_cast<unsigned char>(text[wordEnd]));
+                emit(i, wordLength, wordId);
+                i = wordEnd; // 跳过已处理的字符
+            }
+        }
+    }
+
+    /**
+     * @brief 单次 Aho-Corasick 扫描，按当前模式选择是否做 UTF-8 大小写折叠
+     */
+    template <typename Emit>
+    void scanAutomaton(std::string_view text, Emit&& emit) const {
+        if (normalizer) {
+            compiled.scanNormalized(text, *normalizer, utf8Mode, emit);
+        } else if (utf8Mode) {
+            compiled.scanLongestUtf8(text, emit);
+        } else {
+            compiled.scanLongest(text, emit);
+        }
+    }
+
+    std::string normalizeWord(const std::string& word) const {
+        std::string folded = utf8Mode ? Utf8CaseFolder::foldString(word) : toLower(word);
+        return normalizer ? normalizer->normalize(folded) : folded;
+    }
+
+    /**
+     * @brief 词表变化后重新编译；多个线程同时查询时只有一个线程负责编译
+     */
+    void ensureCompiled() const {
+        if (compiledReady.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(compileMutex);
+        if (compiledReady.load(std::memory_order_relaxed)) {
+            return;
+        }
+        compiled = CompiledTrie::compile(*trie->root());
+        compiledReady.store(true, std::memory_order_release);
+    }
+    
+    static std::string toLower(const std::string& str) {
+        std::string lower = str;
+        for (char& c : lower) {
+            c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+        }
+        return lower;
+    }
+};
+
+/**
+ * @brief Aho-Corasick 自动机法 - 单次线性扫描检测脏话
+ *
+ * 复用 TrieFilter 编译出的双数组及其失败指针和输出指针，扫描时每个字符只处理一次，
+ * 避免 TrieFilter 在每个起始位置都从根节点重新查找。
+ * 屏蔽结果与 TrieFilter 相同：从左到右，每个位置取最长的匹配。
+ *
+ * 优点：耗时与文本长度成线性关系，适合大规模脏话列表和长文本
+ * 缺点：构建自动机需要额外的时间和内存
+ */
+class AhoCorasickFilter : public TrieFilter {
+public:
+    explicit AhoCorasickFilter(char replacementChar = '*',
+                               std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+                               bool defaultWords = true)
+        : TrieFilter(replacementChar, upstream, defaultWords) {}
+
+    using TrieFilter::containsProfanity;
+
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        ensureCompiled();
+        if (normalizer) {
+            return compiled.containsNormalized(text, *normalizer, utf8Mode);
+        }
+        return utf8Mode ? compiled.containsMatchUtf8(text) : compiled.containsMatch(text);
+    }
+
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        ensureCompiled();
+        scanAutomaton(std::string_view(buf, len), [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            // 替换脏话为指定字符
+            for (size_t k = 0; k < length; ++k) {
+                buf[start + k] = replacementChar;
+            }
+        });
+    }
+
+    void censorMask(std::string_view text, std::vector<uint64_t>& mask) const override {
+        auto scope = recordCall(MetricsOperation::Censor, text.size());
+        ensureCompiled();
+        mask.assign(maskWords(text.size()), 0);
+        scanAutomaton(text, [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            markMask(mask, start, length);
+        });
+    }
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        ensureCompiled();
+        scanAutomaton(text, [&](size_t start, size_t length, uint32_t patternId) {
+            scope.match(patternId);
+            matches.push_back({start, length, patternId});
+        });
+    }
+};
+
+/**
+ * @brief 编译期生成的字典树：字节先映射为字符类，再查 状态 × 字符类 的稠密转移表
+ *
+ * 状态 0 是根状态；除根状态以外的状态都不会转移回根状态，因此转移结果为 0 表示没有子状态。
+ * 字符类 0 是不出现在任何词中的字节，它在每个状态下的转移都是 0。
+ * @tparam States 状态数（所有词的长度之和加一）
+ * @tparam Classes 字符类数（词中出现的不同字节数加一）
+ */
+template <size_t States, size_t Classes>
+struct StaticTrieTable {
+    static_assert(States <= 65536, "词表过大，请使用 TrieFilter");
+
+    std::array<uint8_t, 256> byteClass{};
+    std::array<std::array<uint16_t, Classes>, States> next{};
+    std::array<uint32_t, States> pattern{}; // 词尾状态为脏话编号加一，其余为 0
+    // 前两个字节的字符类能否作为某个词的开头（单字节的词对任意第二个字节都成立）
+    std::array<std::array<bool, Classes>, Classes> startsWord{};
+    std::array<uint8_t, 16> lowNibbles{}; // 所有首字节的半字节表，见 FirstBytePrefilter::addNibble
+    size_t longest = 0;
+
+    constexpr uint16_t child(uint16_t state, unsigned char c) const {
+        return next[state][byteClass[c]];
+    }
+
+    /**
+     * @brief 查找不小于 from 的第一个可能是词的开头的位置，没有时返回 len
+     *
+     * 与 FirstBytePrefilter 共用向量化的查找，再用前两个字节的字符类精确判断。
+     */
+    size_t nextCandidate(const char* data, size_t len, size_t from) const {
+        return FirstBytePrefilter::findCandidate(lowNibbles, data, len, from,
+                                                 [this](const char* text, size_t size, size_t pos) {
+                                                     uint8_t first = byteClass[static_cast<unsigned char>(text[pos])];
+                                                     if (pos + 1 == size) {
+                                                         return next[0][first] != 0;
+                                                     }
+                                                     return startsWord[first][byteClass[static_cast<unsigned char>(text[pos + 1])]];
+                                                 });
+    }
+};
+
+/**
+ * @brief 在编译期由固定词表生成 StaticTrieTable，词按 foldCase 转为小写
+ *
+ * 编号为词在列表中的下标；重复的词保留第一次出现的编号，空串被忽略。
+ */
+class StaticTrieBuilder {
+public:
+    template <size_t N>
+    static constexpr size_t stateCount(const std::string_view (&words)[N]) {
+        size_t count = 1;
+        for (std::string_view word : words) {
+            count += word.size();
+        }
+        return count;
+    }
+
+    template <size_t N>
+    static constexpr size_t classCount(const std::string_view (&words)[N]) {
+        return byteClasses(words).count;
+    }
+
+    template <size_t States, size_t Classes, size_t N>
+    static constexpr StaticTrieTable<States, Classes> build(const std::string_view (&words)[N]) {
+        StaticTrieTable<States, Classes> table{};
+        table.byteClass = byteClasses(words).byteClass;
+        size_t used = 1;
+        for (size_t id = 0; id < N; ++id) {
+            if (words[id].empty()) {
+                continue;
+            }
+            size_t state = 0;
+            for (char c : words[id]) {
+                uint8_t cls = table.byteClass[static_cast<unsigned char>(c)];
+                if (table.next[state][cls] == 0) {
+                    table.next[state][cls] = static_cast<uint16_t>(used++);
+                }
+                state = table.next[state][cls];
+            }
+            if (table.pattern[state] == 0) {
+                table.pattern[state] = static_cast<uint32_t>(id + 1);
+            }
+            table.longest = std::max(table.longest, words[id].size());
+        }
+        for (size_t first = 1; first < Classes; ++first) {
+            size_t state = table.next[0][first];
+            for (size_t second = 0; state != 0 && second < Classes; ++second) {
+                table.startsWord[first][second] = table.pattern[state] != 0 || table.next[state][second] != 0;
+            }
+        }
+        for (int c = 0; c < 256; ++c) {
+            if (table.child(0, static_cast<unsigned char>(c)) != 0) {
+                FirstBytePrefilter::addNibble(table.lowNibbles, static_cast<unsigned char>(c));
+            }
+        }
+        return table;
+    }
+
+private:
+    struct ByteClasses {
+        std::array<uint8_t, 256> byteClass{};
+        size_t count = 1;
+    };
+
+    /**
+     * @brief 给词中出现的每个（折叠后的）字节分配一个字符类，大写字母与对应的小写字母同类
+     */
+    template <size_t N>
+    static constexpr ByteClasses byteClasses(const std::string_view (&words)[N]) {
+        ByteClasses classes{};
+        for (std::string_view word : words) {
+            for (char c : word) {
+                unsigned char folded = foldCase(static_cast<unsigned char>(c));
+                if (classes.byteClass[folded] == 0) {
+                    classes.byteClass[folded] = static_cast<uint8_t>(classes.count++);
+                }
+            }
+        }
+        for (int c = 'A'; c <= 'Z'; ++c) {
+            classes.byteClass[c] = classes.byteClass[c - 'A' + 'a'];
+        }
+        return classes;
+    }
+};
 
 /**
- * @brief 脏话屏蔽基类，定义统一接口
+ * @brief 默认脏话列表，可以作为 StaticTrieFilter 的词表
  */
-class ProfanityFilter {
+struct DefaultProfanityWords {
+    static constexpr std::string_view words[] = {"shit", "fuck", "damn", "ass", "bitch", "bastard"};
+};
+
+/**
+ * @brief 编译期字典树法 - 词表在编译时确定，转移表是只读的静态数据
+ *
+ * WordList 是带有 static constexpr std::string_view words[] 成员的类型，如 DefaultProfanityWords。
+ * 整个字典树在编译期生成：构造时不做任何工作，查询时不分配堆内存，
+ * 内层循环每个字节只查两次表，没有哈希查找和失败指针。
+ * 屏蔽结果与使用同一词表的 TrieFilter 相同（从左到右，每个位置取最长的词）。
+ * 大小写只按 ASCII 折叠；不支持运行时添加脏话、单词边界和白名单，这些调用只输出错误信息。
+ *
+ * 优点：没有启动开销，适合只使用内置词表的服务
+ * 缺点：修改词表需要重新编译，词表过大时编译变慢
+ */
+template <typename WordList>
+class StaticTrieFilter : public ProfanityFilter {
 public:
-    virtual ~ProfanityFilter() = default;
+    explicit StaticTrieFilter(char replacementChar = '*') : replacementChar(replacementChar) {}
+
+    using ProfanityFilter::containsProfanity;
+
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        bool found = false;
+        scan(text, [&](const Match&) {
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        scan(std::string_view(buf, len), [&](const Match& match) {
+            scope.match(match.patternId);
+            std::fill_n(buf + match.offset, match.length, replacementChar);
+            return true;
+        });
+    }
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        scan(text, [&](const Match& match) {
+            scope.match(match.patternId);
+            matches.push_back(match);
+            return true;
+        });
+    }
+
+    void addProfanity(const std::string& word) override {
+        reportFixed(word);
+    }
+
+    void addProfanity(const std::string& word, BoundaryMode) override {
+        reportFixed(word);
+    }
+
+    void addAllowedPhrase(const std::string& phrase) override {
+        reportFixed(phrase);
+    }
+
+    void loadFromFile(const std::string& filename) override {
+        reportFixed(filename);
+    }
+
+    /**
+     * @brief 编译期生成的转移表，供调用方检查大小等信息
+     */
+    static constexpr const auto& table() {
+        return kTable;
+    }
+
+private:
+    static constexpr size_t kStates = StaticTrieBuilder::stateCount(WordList::words);
+    static constexpr size_t kClasses = StaticTrieBuilder::classCount(WordList::words);
+    static constexpr StaticTrieTable<kStates, kClasses> kTable =
+        StaticTrieBuilder::build<kStates, kClasses>(WordList::words);
+
+    char replacementChar;
+
+    /**
+     * @brief 从左到右依次输出不重叠的匹配，visit(match) 返回 false 时停止；visit 只会修改已经读过的字节
+     */
+    template <typename Visit>
+    static void scan(std::string_view text, Visit&& visit) {
+        for (size_t i = kTable.nextCandidate(text.data(), text.length(), 0); i < text.length();
+             i = kTable.nextCandidate(text.data(), text.length(), i)) {
+            Match match = longestAt(text, i);
+            if (match.length == 0) {
+                ++i;
+                continue;
+            }
+            if (!visit(match)) {
+                return;
+            }
+            i += match.length;
+        }
+    }
+
+    /**
+     * @brief 从 start 开始的最长的词，没有时 length 为 0
+     */
+    static Match longestAt(std::string_view text, size_t start) {
+        Match match{start, 0, 0};
+        uint16_t state = kTable.child(0, static_cast<unsigned char>(text[start]));
+        size_t end = std::min(text.length(), start + kTable.longest);
+        for (size_t j = start + 1; state != 0; ++j) {
+            if (kTable.pattern[state] != 0) {
+                match.length = j - start;
+                match.patternId = kTable.pattern[state] - 1;
+            }
+            if (j == end) {
+                break;
+            }
+            state = kTable.child(state, static_cast<unsigned char>(text[j]));
+        }
+        return match;
+    }
+
+    static void reportFixed(const std::string& what) {
+        std::cerr << "StaticTrieFilter 的词表在编译时确定，忽略: " << what << std::endl;
+    }
+};
+
+/**
+ * @brief 近似匹配过滤器 - 找出与某个脏话的编辑距离（Levenshtein）不超过该词阈值的片段
+ *
+ * 拼写变体（fuk、fucc、b1tch）不需要逐个写成正则表达式。所有脏话放在一棵按层展开的字典树中，
+ * 从每个可能的起点沿字典树深度优先搜索，每个节点由父节点的动态规划行算出自己的一行；
+ * 行中只保留与深度相差不超过最大阈值的一条带，超过子树内最大阈值的分支立即剪掉。
+ * 首字母必须相同（忽略大小写），起点由首字节表预过滤。同一个起点上，每个词先在各个结束位置中
+ * 取编辑距离最小、其次最长的一个，各个词之间再取最长的匹配，长度相同时取距离较小的，
+ * 从左到右不重叠地输出。距离按字节计算，多字节字符的一次修改算作多次。
+ *
+ * 优点：一个词覆盖所有阈值内的变体，不需要成千上万条正则表达式
+ * 缺点：阈值过大时会误伤正常单词（如 shit 与 shot、bitch 与 batch），默认词表只做精确匹配
+ */
+class FuzzyFilter : public ProfanityFilter {
+public:
+    static constexpr unsigned kMaxDistance = 3;
+    static constexpr size_t kStackRows = 4096;
+
+    /**
+     * @param defaultWords 是否加入默认词表；默认词只做精确匹配，按 defaultDistance 取阈值时
+     *        "batch"、"bustard" 都与默认词只差一处。需要近似匹配的词用 addProfanity(word, maxDistance) 添加
+     */
+    explicit FuzzyFilter(char replacementChar = '*', bool defaultWords = true) : replacementChar(replacementChar) {
+        if (defaultWords) {
+            for (std::string_view word : DefaultProfanityWords::words) {
+                addProfanity(std::string(word), 0u);
+            }
+        }
+    }
+
+    using ProfanityFilter::addProfanity;
+    using ProfanityFilter::containsProfanity;
+
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        ensureCompiled();
+        bool found = false;
+        scanFuzzy(text, [&](size_t start, size_t length, uint32_t) {
+            found = allowedPhrases.empty() || !overlapsAllowed(text, start, length);
+            return !found;
+        });
+        return found;
+    }
+
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        ScratchMatches scratch;
+        std::vector<Match>& matches = scratch.get();
+        findMatches(std::string_view(buf, len), matches);
+        applyMatches(buf, len, matches, replacementChar);
+    }
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        ensureCompiled();
+        size_t first = matches.size();
+        scanFuzzy(text, [&](size_t start, size_t length, uint32_t patternId) {
+            matches.push_back({start, length, patternId});
+            return true;
+        });
+        removeAllowed(text, matches, first, allowedPhrases);
+        scope.matches(matches.data() + first, matches.data() + matches.size());
+    }
+
+    void addProfanity(const std::string& word) override {
+        addProfanity(word, BoundaryMode::Substring);
+    }
+
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        addProfanity(word, defaultDistance(word.size()), boundary);
+    }
+
+    /**
+     * @brief 添加脏话并指定编辑距离阈值；同一个词再次添加时保留编号，阈值和边界要求以最后一次为准
+     * @param maxDistance 允许的最大编辑距离，超过 kMaxDistance 时按 kMaxDistance 处理
+     */
+    void addProfanity(const std::string& word, unsigned maxDistance, BoundaryMode boundary = BoundaryMode::Substring) {
+        if (word.empty()) {
+            return;
+        }
+        WordInfo info{static_cast<uint32_t>(words.size()), static_cast<uint8_t>(std::min(maxDistance, kMaxDistance)),
+                      boundary};
+        auto [it, added] = words.emplace(toLower(word), info);
+        if (!added) {
+            it->second.distance = info.distance;
+            it->second.boundary = boundary;
+        }
+        compiledReady.store(false, std::memory_order_release);
+    }
+
+    void addAllowedPhrase(const std::string& phrase) override {
+        if (!phrase.empty()) {
+            allowedPhrases.push_back(toLower(phrase));
+        }
+    }
+
+    void loadFromFile(const std::string& filename) override {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return;
+        }
+
+        std::string word;
+        while (std::getline(file, word)) {
+            if (!word.empty()) {
+                addProfanity(word);
+            }
+        }
+    }
+
+    void compile() override {
+        ensureCompiled();
+    }
+
+    bool empty() const {
+        return words.empty();
+    }
+
+    /**
+     * @brief addProfanity(word) 使用的阈值：不超过 4 个字节的词只做精确匹配，
+     *        5 到 8 个字节允许 1 处编辑，更长的词允许 2 处；与常用词相近的词应显式指定阈值
+     */
+    static unsigned defaultDistance(size_t length) {
+        return length <= 4 ? 0 : length <= 8 ? 1 : 2;
+    }
+
+private:
+    struct WordInfo {
+        uint32_t id;
+        uint8_t distance;
+        BoundaryMode boundary;
+    };
+
+    /**
+     * @brief 按层展开的字典树节点，子节点连续存放
+     */
+    struct Node {
+        uint32_t firstChild = 0;
+        uint32_t childCount = 0;
+        int32_t word = -1;          // 以该节点结尾的词在 wordInfo 中的下标
+        unsigned char byte = 0;     // 到达该节点的字节（已转为小写）
+        uint8_t subtreeDistance = 0; // 子树中各词阈值的最大值，用于剪枝
+    };
+
+    // 脏话 -> 编号、阈值和边界要求
+    std::map<std::string, WordInfo> words;
+    std::vector<std::string> allowedPhrases; // 已转为小写
+    char replacementChar;
+
+    mutable std::vector<Node> nodes;
+    mutable std::vector<WordInfo> wordInfo;
+    mutable std::array<uint32_t, 256> rootChild{}; // 首字节对应的根的子节点，0 表示没有
+    mutable std::array<uint8_t, 16> lowNibbles{};
+    mutable size_t maxDepth = 0;
+    mutable unsigned maxDistance = 0;
+    mutable std::atomic<bool> compiledReady{false};
+    mutable std::mutex compileMutex;
+
+    /**
+     * @brief 从左到右输出每个起点最长的近似匹配，emit(start, length, patternId) 返回 false 时停止
+     */
+    template <typename Emit>
+    void scanFuzzy(std::string_view text, Emit&& emit) const {
+        if (nodes.size() <= 1) {
+            return;
+        }
+        const size_t width = maxDepth + maxDistance + 1; // 每行最多覆盖的文本长度加一
+        // 动态规划的各行，较短时位于栈上
+        uint8_t stackRows[kStackRows];
+        std::vector<uint8_t> heapRows;
+        uint8_t* rows = stackRows;
+        if ((maxDepth + 1) * width > kStackRows) {
+            heapRows.resize((maxDepth + 1) * width);
+            rows = heapRows.data();
+        }
+        auto isStart = [&](const char*, size_t, size_t pos) {
+            return rootChild[foldCase(static_cast<unsigned char>(text[pos]))] != 0;
+        };
+
+        for (size_t i = FirstBytePrefilter::findCandidate(lowNibbles, text.data(), text.size(), 0, isStart);
+             i < text.size();) {
+            size_t limit = std::min(width - 1, text.size() - i); // 本起点最多读取的字节数
+            size_t bestLength = 0;
+            uint8_t bestDistance = 0;
+            uint32_t bestId = 0;
+            auto consider = [&](const WordInfo& info, size_t length, uint8_t distance) {
+                if (length > bestLength || (length == bestLength && distance < bestDistance)) {
+                    bestLength = length;
+                    bestDistance = distance;
+                    bestId = info.id;
+                }
+            };
+
+            // 第一层：首字母与 text[i] 相同，row[j] = j - 1（j >= 1）
+            uint32_t top = rootChild[foldCase(static_cast<unsigned char>(text[i]))];
+            uint8_t* first = rows + width;
+            for (size_t j = 0; j <= std::min<size_t>(limit, 1 + maxDistance); ++j) {
+                first[j] = static_cast<uint8_t>(j == 0 ? 1 : j - 1);
+            }
+            search(text, i, limit, top, 1, rows, width, consider);
+
+            if (bestLength > 0) {
+                if (!emit(i, bestLength, bestId)) {
+                    return;
+                }
+                i += bestLength;
+            } else {
+                ++i;
+            }
+            i = FirstBytePrefilter::findCandidate(lowNibbles, text.data(), text.size(), i, isStart);
+        }
+    }
+
+    /**
+     * @brief 深度优先搜索：rows 的第 depth 行已经是 node 的动态规划行
+     *
+     * row[j] 是该节点对应的前缀与 text[start, start + j) 的编辑距离，只计算 |j - depth| 不超过最大阈值的一条带，
+     * 带外和大于 kMaxDistance 的值都记为 kMaxDistance + 1。
+     */
+    template <typename Consider>
+    void search(std::string_view text, size_t start, size_t limit, uint32_t node, size_t depth, uint8_t* rows,
+                size_t width, Consider& consider) const {
+        constexpr uint8_t kFar = kMaxDistance + 1;
+        const uint8_t* row = rows + depth * width;
+        const size_t low = depth > maxDistance ? depth - maxDistance : 0;
+        const size_t high = std::min(limit, depth + maxDistance);
+
+        const Node& current = nodes[node];
+        if (current.word >= 0) {
+            const WordInfo& info = wordInfo[current.word];
+            // 同一个词在满足边界要求的结束位置中取编辑距离最小、其次最长的一个
+            size_t length = 0;
+            uint8_t distance = kFar;
+            for (size_t j = std::max<size_t>(low, 1); j <= high; ++j) {
+                if (row[j] <= info.distance && row[j] <= distance && matchesBoundary(text, start, j, info.boundary)) {
+                    length = j;
+                    distance = row[j];
+                }
+            }
+            if (length > 0) {
+                consider(info, length, distance);
+            }
+        }
+        if (depth >= maxDepth) {
+            return;
+        }
+
+        uint8_t* next = rows + (depth + 1) * width;
+        const size_t nextLow = depth + 1 > maxDistance ? depth + 1 - maxDistance : 0;
+        const size_t nextHigh = std::min(limit, depth + 1 + maxDistance);
+        for (uint32_t c = current.firstChild; c < current.firstChild + current.childCount; ++c) {
+            const Node& child = nodes[c];
+            uint8_t best = kFar;
+            for (size_t j = nextLow; j <= nextHigh; ++j) {
+                // 删除词中的字符、插入正文中的字符、替换或相同
+                unsigned value = (j >= low && j <= high ? row[j] : kFar) + 1u;
+                if (j > nextLow) {
+                    value = std::min<unsigned>(value, next[j - 1] + 1u);
+                }
+                if (j > 0 && j - 1 >= low && j - 1 <= high) {
+                    unsigned char b = foldCase(static_cast<unsigned char>(text[start + j - 1]));
+                    value = std::min<unsigned>(value, row[j - 1] + (b == child.byte ? 0u : 1u));
+                }
+                next[j] = static_cast<uint8_t>(std::min<unsigned>(value, kFar));
+                best = std::min(best, next[j]);
+            }
+            if (best <= child.subtreeDistance) {
+                search(text, start, limit, c, depth + 1, rows, width, consider);
+            }
+        }
+    }
+
+    bool overlapsAllowed(std::string_view text, size_t start, size_t length) const {
+        std::vector<Match> single{{start, length, 0}};
+        removeAllowed(text, single, 0, allowedPhrases);
+        return single.empty();
+    }
+
+    /**
+     * @brief 词表变化后重新展开字典树；多个线程同时查询时只有一个线程负责构建
+     */
+    void ensureCompiled() const {
+        if (compiledReady.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(compileMutex);
+        if (compiledReady.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        // 有序的词表中，同一个前缀的词相邻；逐层展开，每层的子节点按字节排列
+        std::vector<std::pair<std::string_view, const WordInfo*>> sorted;
+        for (const auto& [word, info] : words) {
+            sorted.emplace_back(word, &info);
+        }
+        nodes.assign(1, Node{});
+        wordInfo.clear();
+        rootChild.fill(0);
+        lowNibbles.fill(0);
+        maxDepth = 0;
+        maxDistance = 0;
+
+        struct Range {
+            uint32_t node;
+            size_t begin, end, depth; // sorted[begin, end) 共享该节点的前缀
+        };
+        std::deque<Range> pending{{0, 0, sorted.size(), 0}};
+        while (!pending.empty()) {
+            Range range = pending.front();
+            pending.pop_front();
+            nodes[range.node].firstChild = static_cast<uint32_t>(nodes.size());
+            size_t i = range.begin;
+            if (i < range.end && sorted[i].first.size() == range.depth) {
+                nodes[range.node].word = static_cast<int32_t>(wordInfo.size());
+                wordInfo.push_back(*sorted[i].second);
+                ++i;
+            }
+            while (i < range.end) {
+                unsigned char byte = static_cast<unsigned char>(sorted[i].first[range.depth]);
+                size_t j = i;
+                uint8_t subtree = 0;
+                while (j < range.end && static_cast<unsigned char>(sorted[j].first[range.depth]) == byte) {
+                    subtree = std::max(subtree, sorted[j].second->distance);
+                    maxDepth = std::max(maxDepth, sorted[j].first.size());
+                    ++j;
+                }
+                Node child;
+                child.byte = byte;
+                child.subtreeDistance = subtree;
+                uint32_t index = static_cast<uint32_t>(nodes.size());
+                nodes.push_back(child);
+                ++nodes[range.node].childCount;
+                pending.push_back({index, i, j, range.depth + 1});
+                if (range.depth == 0) {
+                    rootChild[byte] = index;
+                    FirstBytePrefilter::addNibble(lowNibbles, byte);
+                    if (byte >= 'a' && byte <= 'z') {
+                        FirstBytePrefilter::addNibble(lowNibbles, static_cast<unsigned char>(byte - ('a' - 'A')));
+                    }
+                }
+                maxDistance = std::max<unsigned>(maxDistance, subtree);
+                i = j;
+            }
+        }
+        compiledReady.store(true, std::memory_order_release);
+    }
+
+    static std::string toLower(const std::string& str) {
+        std::string lower = str;
+        for (char& c : lower) {
+            c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+        }
+        return lower;
+    }
+};
+
+/**
+ * @brief 混合过滤器 - 结合多种过滤技术
+ * 
+ * 添加脏话时按内容分配引擎：不含正则元字符的普通词只交给自动机（AhoCorasickFilter），
+ * 含有元字符的模式（如 f[aeiou*]+ck）只交给正则表达式引擎，每个词只被匹配一次。
+ * 查询时只运行有词的引擎；只有一个引擎可用时直接交给它，不合并区间。
+ * 简单替换法只在 configureFilters 关闭自动机时代替它，此时才由自动机的词表生成，之后同步添加。
+ * addFuzzyProfanity 添加的词由近似匹配引擎（FuzzyFilter）匹配，与其他引擎的结果合并。
+ * 
+ * 优点：结合多种技术的优点，耗时接近可用引擎中最快的一个
+ * 缺点：实现复杂，资源消耗较大
+ */
+class HybridFilter : public ProfanityFilter {
+private:
+    std::unique_ptr<SimpleReplacementFilter> simpleFilter; // 只在代替自动机时存在
+    std::unique_ptr<RegexFilter> regexFilter;
+    std::unique_ptr<TrieFilter> trieFilter;
+    std::unique_ptr<FuzzyFilter> fuzzyFilter;
+    char replacementChar;
+    
+    // 使用哪种过滤器（可配置）；是否使用简单替换法由 simpleFilter 是否存在表示
+    bool useRegexFilter = true;
+    bool useTrieFilter = true;
+    
+public:
+    // findMatches 结果中 patternId 的最高两位表示来源过滤器
+    static constexpr uint32_t kSimpleSource = 0u << 30;
+    static constexpr uint32_t kRegexSource = 1u << 30;
+    static constexpr uint32_t kTrieSource = 2u << 30;
+    static constexpr uint32_t kFuzzySource = 3u << 30;
+    static constexpr uint32_t kSourceMask = 3u << 30;
+    
+    explicit HybridFilter(char replacementChar = '*') : replacementChar(replacementChar) {
+        // 默认词表中的普通词由自动机匹配，正则表达式引擎只保留变体模式
+        regexFilter = std::make_unique<RegexFilter>(replacementChar, false);
+        trieFilter = std::make_unique<AhoCorasickFilter>(replacementChar);
+        fuzzyFilter = std::make_unique<FuzzyFilter>(replacementChar, false);
+        regexFilter->addVariantPatterns();
+    }
+    
+    using ProfanityFilter::containsProfanity;
+    
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        const ProfanityFilter* literal = literalEngine();
+        if (literal != nullptr && literal->containsProfanity(text)) {
+            return true;
+        }
+        if (usesRegex() && regexFilter->containsProfanity(text)) {
+            return true;
+        }
+        return !fuzzyFilter->empty() && fuzzyFilter->containsProfanity(text);
+    }
+    
+    // 合并各过滤器在原文上的匹配区间，只屏蔽一次
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        const ProfanityFilter* engines[] = {literalEngine(), usesRegex() ? regexFilter.get() : nullptr,
+                                            fuzzyFilter->empty() ? nullptr : fuzzyFilter.get()};
+        size_t available = std::count_if(std::begin(engines), std::end(engines),
+                                         [](const ProfanityFilter* engine) { return engine != nullptr; });
+        if (available <= 1) {
+            // 只有一个引擎可用，直接在原处屏蔽
+            for (const ProfanityFilter* engine : engines) {
+                if (engine != nullptr) {
+                    engine->censorInPlace(buf, len);
+                }
+            }
+            return;
+        }
+        ScratchMatches scratch;
+        std::vector<Match>& matches = scratch.get();
+        findMatches(std::string_view(buf, len), matches);
+        applyMatches(buf, len, matches, replacementChar);
+    }
+    
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        size_t first = matches.size();
+        if (const ProfanityFilter* literal = literalEngine()) {
+            collectMatches(*literal, text, literal == trieFilter.get() ? kTrieSource : kSimpleSource, matches);
+        }
+        if (usesRegex()) {
+            collectMatches(*regexFilter, text, kRegexSource, matches);
+        }
+        if (!fuzzyFilter->empty()) {
+            collectMatches(*fuzzyFilter, text, kFuzzySource, matches);
+        }
+        scope.matches(matches.data() + first, matches.data() + matches.size());
+    }
+    
+    void addProfanity(const std::string& word) override {
+        addProfanity(word, BoundaryMode::Substring);
+    }
+
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        if (isLiteral(word)) {
+            trieFilter->addProfanity(word, boundary);
+            if (simpleFilter) {
+                simpleFilter->addProfanity(word, boundary);
+            }
+        } else {
+            regexFilter->addProfanity(word, boundary);
+        }
+    }
+
+    /**
+     * @brief 添加按编辑距离近似匹配的脏话，由 FuzzyFilter 匹配，与其他引擎的结果合并
+     * @param maxDistance 允许的最大编辑距离，见 FuzzyFilter::addProfanity
+     */
+    void addFuzzyProfanity(const std::string& word, unsigned maxDistance,
+                           BoundaryMode boundary = BoundaryMode::Substring) {
+        fuzzyFilter->addProfanity(word, maxDistance, boundary);
+    }
+
+    // 各过滤器使用同一份白名单，合并前已经去掉了重叠的匹配
+    void addAllowedPhrase(const std::string& phrase) override {
+        if (simpleFilter) {
+            simpleFilter->addAllowedPhrase(phrase);
+        }
+        regexFilter->addAllowedPhrase(phrase);
+        trieFilter->addAllowedPhrase(phrase);
+        fuzzyFilter->addAllowedPhrase(phrase);
+    }
+    
+    // 逐行按内容分配引擎，与 addProfanity 相同
+    void loadFromFile(const std::string& filename) override {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return;
+        }
+        
+        std::string word;
+        while (std::getline(file, word)) {
+            if (!word.empty()) {
+                addProfanity(word);
+            }
+        }
+        file.close();
+    }
     
-    /**
-     * @brief 检测文本中是否包含脏话
-     * @param text 待检测文本
-     * @return true 如果包含脏话
-     */
-    virtual bool containsProfanity(const std::string& text) const = 0;
+    void compile() override {
+        if (simpleFilter) {
+            simpleFilter->compile();
+        }
+        regexFilter->compile();
+        trieFilter->compile();
+        fuzzyFilter->compile();
+    }
     
+#if defined(PROFANITY_FILTER_METRICS)
     /**
-     * @brief 屏蔽文本中的脏话
-     * @param text 待处理文本
-     * @return 处理后的文本
+     * @brief 混合过滤器自身和各子过滤器的统计信息，可以直接交给 MetricsSnapshot::writePrometheus
+     *
+     * 子过滤器的耗时是混合过滤器耗时的组成部分；混合过滤器的编号带有来源位（见 kSourceMask）。
      */
-    virtual std::string censor(const std::string& text) const = 0;
+    std::vector<std::pair<std::string, MetricsSnapshot>> metricsSnapshots() const {
+        return {{"hybrid", metricsSnapshot()},
+                {"simple", simpleFilter ? simpleFilter->metricsSnapshot() : MetricsSnapshot()},
+                {"regex", regexFilter->metricsSnapshot()},
+                {"trie", trieFilter->metricsSnapshot()},
+                {"fuzzy", fuzzyFilter->metricsSnapshot()}};
+    }
+#endif
     
     /**
-     * @brief 添加脏话到过滤列表
-     * @param word 脏话
+     * @brief 配置允许使用哪些过滤器
+     *
+     * 普通词优先由自动机匹配，关闭自动机后改由简单替换法匹配；两者都关闭时普通词不再屏蔽。
+     * 简单替换法在这里由自动机的词表和白名单生成，不再使用时释放。
      */
-    virtual void addProfanity(const std::string& word) = 0;
-    
+    void configureFilters(bool useSimple, bool useRegex, bool useTrie) {
+        useRegexFilter = useRegex;
+        useTrieFilter = useTrie;
+        if (useTrie || !useSimple) {
+            simpleFilter.reset();
+        } else if (!simpleFilter) {
+            auto simple = std::make_unique<SimpleReplacementFilter>(replacementChar);
+            trieFilter->forEachWord([&](const std::string& word, BoundaryMode boundary, bool allowed) {
+                if (allowed) {
+                    simple->addAllowedPhrase(word);
+                } else {
+                    simple->addProfanity(word, boundary);
+                }
+            });
+            simpleFilter = std::move(simple);
+        }
+    }
+
     /**
-     * @brief 从文件加载脏话列表
-     * @param filename 文件名
+     * @brief 是否含有正则元字符；不含时按普通词匹配
      */
-    virtual void loadFromFile(const std::string& filename) = 0;
+    static bool isLiteral(std::string_view word) {
+        return word.find_first_of("\\^$.|?*+()[]{}") == std::string_view::npos;
+    }
+    
+private:
+    // 匹配普通词的引擎
+    const ProfanityFilter* literalEngine() const {
+        if (useTrieFilter) {
+            return trieFilter.get();
+        }
+        return simpleFilter.get();
+    }
+
+    bool usesRegex() const {
+        return useRegexFilter && regexFilter->hasPatterns();
+    }
+
+    static void collectMatches(const ProfanityFilter& filter, std::string_view text, uint32_t source,
+                               std::vector<Match>& matches) {
+        size_t first = matches.size();
+        filter.findMatches(text, matches);
+        for (size_t i = first; i < matches.size(); ++i) {
+            matches[i].patternId = (matches[i].patternId & ~kSourceMask) | source;
+        }
+    }
 };
 
 /**
- * @brief 简单替换法 - 使用字符串查找和替换
- * 
- * 优点：简单直接，适用于小规模脏话列表
- * 缺点：效率较低，无法处理变体
+ * @brief 静态组合的过滤流水线 - 各引擎在编译期确定，查询时不经过虚函数
+ *
+ * Stages 是具体的过滤器类型，如 FilterPipeline<AhoCorasickFilter, RegexFilter>；
+ * 各引擎直接保存在流水线对象内，查询时用限定名调用，编译器可以把各阶段内联到一起。
+ * 所有引擎在同一份原文上查找，匹配追加到同一个列表，最后只在原处屏蔽一次，
+ * 中间不生成新的字符串。混淆归一化、预过滤和白名单都在各引擎内部完成
+ * （如 stage<0>().setObfuscationNormalizer(...)），不需要单独的阶段。
+ * 需要在运行时开关引擎时使用 HybridFilter。
+ *
+ * 与 HybridFilter 一样按内容分配脏话：普通词只交给非正则引擎，含正则元字符的模式只交给
+ * RegexFilter；流水线中没有对应类型的引擎时交给所有引擎。有非正则引擎时，
+ * RegexFilter 只加载变体模式，默认词表中的普通词由其他引擎匹配。
  */
-class SimpleReplacementFilter : public ProfanityFilter {
-private:
-    std::set<std::string> profanityList;
-    char replacementChar;
-    
+template <typename... Stages>
+class FilterPipeline final : public ProfanityFilter {
+    static_assert(sizeof...(Stages) >= 1 && sizeof...(Stages) <= 4, "流水线需要 1~4 个引擎");
+
 public:
-    explicit SimpleReplacementFilter(char replacementChar = '*') 
-        : replacementChar(replacementChar) {
-        // 默认脏话列表
-        profanityList = {"shit", "fuck", "damn", "ass", "bitch", "bastard"};
+    // findMatches 结果中 patternId 的最高两位表示来源引擎在 Stages 中的下标
+    static constexpr uint32_t kStageShift = 30;
+    static constexpr uint32_t kStageMask = 3u << kStageShift;
+
+    template <size_t I>
+    using StageType = std::tuple_element_t<I, std::tuple<Stages...>>;
+
+    /**
+     * @param replacementChar 替换字符，同时用于构造每个引擎
+     */
+    explicit FilterPipeline(char replacementChar = '*')
+        : stages((static_cast<void>(sizeof(Stages)), SlotOptions{replacementChar, kHasLiteralStage})...),
+          replacementChar(replacementChar) {}
+
+    using ProfanityFilter::containsProfanity;
+
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        return containsAny(text, std::index_sequence_for<Stages...>());
     }
-    
-    bool containsProfanity(const std::string& text) const override {
-        std::string lowerText = toLower(text);
-        
-        for (const auto& word : profanityList) {
-            if (lowerText.find(word) != std::string::npos) {
-                return true;
-            }
+
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        if constexpr (sizeof...(Stages) == 1) {
+            std::get<0>(stages).filter.StageType<0>::censorInPlace(buf, len);
+        } else {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            collectAll(std::string_view(buf, len), matches, std::index_sequence_for<Stages...>());
+            applyMatches(buf, len, matches, replacementChar);
         }
-        return false;
     }
-    
-    std::string censor(const std::string& text) const override {
-        std::string result = text;
-        std::string lowerText = toLower(text);
-        
-        for (const auto& word : profanityList) {
-            size_t pos = 0;
-            while ((pos = lowerText.find(word, pos)) != std::string::npos) {
-                // 替换脏话为指定字符
-                for (size_t i = 0; i < word.length(); ++i) {
-                    result[pos + i] = replacementChar;
-                }
-                pos += word.length();
-            }
-        }
-        
-        return result;
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        size_t first = matches.size();
+        collectAll(text, matches, std::index_sequence_for<Stages...>());
+        scope.matches(matches.data() + first, matches.data() + matches.size());
     }
-    
+
     void addProfanity(const std::string& word) override {
-        profanityList.insert(toLower(word));
+        addProfanity(word, BoundaryMode::Substring);
     }
-    
+
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        bool literal = HybridFilter::isLiteral(word);
+        bool routed = literal ? kHasLiteralStage : kHasRegexStage;
+        forEachStage([&](auto& stage) {
+            if (!routed || isRegexStage(stage) != literal) {
+                stage.addProfanity(word, boundary);
+            }
+        });
+    }
+
+    void addAllowedPhrase(const std::string& phrase) override {
+        forEachStage([&](auto& stage) { stage.addAllowedPhrase(phrase); });
+    }
+
+    // 逐行按内容分配引擎，与 addProfanity 相同
     void loadFromFile(const std::string& filename) override {
         std::ifstream file(filename);
         if (!file.is_open()) {
             std::cerr << "无法打开文件: " << filename << std::endl;
             return;
         }
-        
+
         std::string word;
         while (std::getline(file, word)) {
             if (!word.empty()) {
@@ -109,315 +6942,830 @@ public:
         }
         file.close();
     }
-    
+
+    void compile() override {
+        forEachStage([](auto& stage) { stage.compile(); });
+    }
+
+    /**
+     * @brief 第 I 个引擎，用于单独配置（如开启 UTF-8 模式）
+     */
+    template <size_t I>
+    StageType<I>& stage() {
+        return std::get<I>(stages).filter;
+    }
+
+    template <size_t I>
+    const StageType<I>& stage() const {
+        return std::get<I>(stages).filter;
+    }
+
 private:
-    static std::string toLower(const std::string& str) {
-        std::string lower = str;
-        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-        return lower;
+    template <typename Stage>
+    static constexpr bool isRegexStage(const Stage&) {
+        return std::is_base_of_v<RegexFilter, Stage>;
+    }
+
+    static constexpr bool kHasRegexStage = (std::is_base_of_v<RegexFilter, Stages> || ...);
+    static constexpr bool kHasLiteralStage = (!std::is_base_of_v<RegexFilter, Stages> || ...);
+
+    /**
+     * @brief 在流水线中原地构造一个引擎；有非正则引擎时 RegexFilter 只加载变体模式
+     */
+    struct SlotOptions {
+        char replacementChar;
+        bool variantsOnly;
+    };
+
+    template <typename Stage>
+    struct StageSlot {
+        Stage filter;
+
+        // 各引擎不可移动，由 tuple 用 SlotOptions 原地构造
+        StageSlot(SlotOptions options)
+            : StageSlot(options.replacementChar, options.variantsOnly, std::is_base_of<RegexFilter, Stage>()) {}
+
+        StageSlot(char replacementChar, bool variantsOnly, std::true_type) : filter(replacementChar, !variantsOnly) {
+            if (variantsOnly) {
+                filter.addVariantPatterns();
+            }
+        }
+
+        StageSlot(char replacementChar, bool, std::false_type) : filter(replacementChar) {}
+    };
+
+    std::tuple<StageSlot<Stages>...> stages;
+    char replacementChar;
+
+    template <size_t... I>
+    bool containsAny(std::string_view text, std::index_sequence<I...>) const {
+        return (std::get<I>(stages).filter.StageType<I>::containsProfanity(text) || ...);
+    }
+
+    template <size_t... I>
+    void collectAll(std::string_view text, std::vector<Match>& matches, std::index_sequence<I...>) const {
+        (collectStage<I>(text, matches), ...);
+    }
+
+    template <size_t I>
+    void collectStage(std::string_view text, std::vector<Match>& matches) const {
+        size_t first = matches.size();
+        std::get<I>(stages).filter.StageType<I>::findMatches(text, matches);
+        for (size_t i = first; i < matches.size(); ++i) {
+            matches[i].patternId = (matches[i].patternId & ~kStageMask) | (static_cast<uint32_t>(I) << kStageShift);
+        }
+    }
+
+    template <typename Visit>
+    void forEachStage(Visit&& visit) {
+        std::apply([&](auto&... slot) { (visit(slot.filter), ...); }, stages);
     }
 };
 
 /**
- * @brief 正则表达式法 - 使用正则表达式匹配脏话
- * 
- * 优点：可以处理复杂的模式匹配，支持变体
- * 缺点：正则表达式可能较难维护，性能中等
+ * @brief 支持热更新词表的过滤器句柄（RCU 风格）
+ *
+ * 过滤器在查询期间只读，但 addProfanity/loadFromFile 会原地修改词表，不能和查询并发。
+ * FilterHandle 把编译好的过滤器作为不可变快照发布：读者通过原子 shared_ptr 取得当前快照，
+ * 不加锁；更新时在调用线程（或 reloadAsync 的后台线程）构建并编译新的过滤器，
+ * 再原子地替换快照。旧快照在最后一个读者释放后自动销毁。
+ * 发布后的过滤器不应再被修改。
  */
-class RegexFilter : public ProfanityFilter {
+template <typename Filter>
+class FilterHandle {
+public:
+    /**
+     * @brief 某一版本的过滤器
+     */
+    struct Snapshot {
+        std::shared_ptr<const Filter> filter;
+        uint64_t version;
+    };
+
+    using Factory = std::function<std::unique_ptr<Filter>()>;
+
+    /**
+     * @param factory 构造空过滤器（含默认词表）的函数，reloadFromFile 用它构建新版本
+     */
+    explicit FilterHandle(Factory factory = [] { return std::make_unique<Filter>(); })
+        : factory(std::move(factory)) {
+        publish(this->factory());
+    }
+
+    /**
+     * @brief 取得当前快照；持有期间该版本不会被销毁
+     */
+    std::shared_ptr<const Snapshot> snapshot() const {
+#if defined(__cpp_lib_atomic_shared_ptr)
+        return current.load(std::memory_order_acquire);
+#else
+        return std::atomic_load_explicit(&current, std::memory_order_acquire);
+#endif
+    }
+
+    uint64_t version() const {
+        return snapshot()->version;
+    }
+
+    bool containsProfanity(std::string_view text) const {
+        return snapshot()->filter->containsProfanity(text);
+    }
+
+    std::string censor(std::string_view text) const {
+        return snapshot()->filter->censor(text);
+    }
+
+    /**
+     * @brief 编译并发布一个新的过滤器
+     * @return 新快照的版本号
+     */
+    uint64_t publish(std::unique_ptr<Filter> filter) {
+        filter->compile();
+        std::lock_guard<std::mutex> lock(writerMutex);
+        auto next = std::make_shared<const Snapshot>(Snapshot{std::shared_ptr<const Filter>(std::move(filter)),
+                                                              ++latestVersion});
+#if defined(__cpp_lib_atomic_shared_ptr)
+        current.store(next, std::memory_order_release);
+#else
+        std::atomic_store_explicit(&current, next, std::memory_order_release);
+#endif
+        return next->version;
+    }
+
+    /**
+     * @brief 用 factory 构建新的过滤器，加载 filename 中的词表后发布
+     * @return 新快照的版本号
+     */
+    uint64_t reloadFromFile(const std::string& filename) {
+        std::unique_ptr<Filter> filter = factory();
+        filter->loadFromFile(filename);
+        return publish(std::move(filter));
+    }
+
+    /**
+     * @brief 在后台线程中执行 reloadFromFile，查询不受影响
+     */
+    std::future<uint64_t> reloadAsync(const std::string& filename) {
+        return std::async(std::launch::async, [this, filename] { return reloadFromFile(filename); });
+    }
+
+private:
+    Factory factory;
+    std::mutex writerMutex; // 只在发布者之间互斥
+    uint64_t latestVersion = 0;
+#if defined(__cpp_lib_atomic_shared_ptr)
+    std::atomic<std::shared_ptr<const Snapshot>> current;
+#else
+    std::shared_ptr<const Snapshot> current;
+#endif
+};
+
+/**
+ * @brief 租户附加词表：只保存租户自己的少量脏话和白名单，由 TenantFilterRegistry 的加载函数填充
+ *
+ * 白名单短语不编译进自动机，而是由 TenantFilter 作用于基础词表和附加词表的全部匹配。
+ */
+class TenantOverlay : public AhoCorasickFilter {
+public:
+    explicit TenantOverlay(char replacementChar = '*') : AhoCorasickFilter(replacementChar, std::pmr::new_delete_resource(), false) {}
+
+    /**
+     * @brief 与基础词表的 UTF-8 模式一致地折叠大小写，应在 setUtf8Mode 之后添加
+     */
+    void addAllowedPhrase(const std::string& phrase) override {
+        if (!phrase.empty()) {
+            phrases.push_back(isUtf8Mode() ? Utf8CaseFolder::foldString(phrase) : toLower(phrase));
+        }
+    }
+
+    /**
+     * @brief 已折叠大小写的白名单短语
+     */
+    const std::vector<std::string>& allowedPhrases() const {
+        return phrases;
+    }
+
+    /**
+     * @brief 是否没有任何附加脏话
+     */
+    bool empty() const {
+        return compiledTrie().longestWordLength() == 0;
+    }
+
+private:
+    std::vector<std::string> phrases;
+};
+
+/**
+ * @brief 一个租户的过滤器：共享的基础词表加上该租户的附加词表，两个自动机在同一次扫描中运行
+ *
+ * 基础词表和附加词表都是只读的共享快照，多个租户共用同一个基础词表，
+ * 每个租户只占用附加词表的内存。两份词表各自按最长匹配屏蔽，结果合并后只屏蔽一次；
+ * 租户的白名单对两份词表的匹配都有效，基础词表自己的白名单只作用于基础词表。
+ * findMatches 中附加词表的编号带有 kOverlaySource 位。
+ * 本身不能修改，修改词表的调用只输出错误信息，应通过 TenantFilterRegistry 修改。
+ */
+class TenantFilter final : public ProfanityFilter {
+public:
+    static constexpr uint32_t kOverlaySource = 1u << 31;
+
+    TenantFilter(std::shared_ptr<const TrieFilter> base, std::shared_ptr<const TenantOverlay> overlay,
+                 char replacementChar = '*')
+        : base(std::move(base)), overlay(std::move(overlay)), replacementChar(replacementChar) {}
+
+    using ProfanityFilter::containsProfanity;
+
+    // 没有白名单时两个自动机各自遇到第一个匹配即返回
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        if (!overlay->allowedPhrases().empty()) {
+            ScratchMatches scratch;
+            std::vector<Match>& matches = scratch.get();
+            findMatches(text, matches);
+            return !matches.empty();
+        }
+        return base->containsProfanity(text) || (!overlay->empty() && overlay->containsProfanity(text));
+    }
+
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        // 两个自动机读的是同一块原文，先找出所有位置再统一替换
+        ScratchMatches scratch;
+        std::vector<Match>& matches = scratch.get();
+        findMatches(std::string_view(buf, len), matches);
+        applyMatches(buf, len, matches, replacementChar);
+    }
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        auto scope = recordCall(MetricsOperation::FindMatches, text.size());
+        size_t first = matches.size();
+        if (overlay->empty()) {
+            base->findMatches(text, matches);
+        } else if (base->obfuscationNormalizer()) {
+            // 归一化扫描的状态更复杂，两个自动机分别扫描
+            base->findMatches(text, matches);
+            size_t overlayFirst = matches.size();
+            overlay->findMatches(text, matches);
+            markOverlay(matches, overlayFirst);
+        } else {
+            CompiledTrie::scanLongestPair(
+                base->compiledTrie(), overlay->compiledTrie(), text, base->isUtf8Mode(),
+                [&](size_t start, size_t length, uint32_t patternId) { matches.push_back({start, length, patternId}); },
+                [&](size_t start, size_t length, uint32_t patternId) {
+                    matches.push_back({start, length, patternId | kOverlaySource});
+                });
+        }
+        if (base->isUtf8Mode() && !overlay->allowedPhrases().empty() && matches.size() > first) {
+            // 折叠不改变字节数，在折叠后的副本上查找白名单短语，位置与原文相同
+            removeAllowed(Utf8CaseFolder::foldString(text), matches, first, overlay->allowedPhrases());
+        } else {
+            removeAllowed(text, matches, first, overlay->allowedPhrases());
+        }
+        scope.matches(matches.data() + first, matches.data() + matches.size());
+    }
+
+    void addProfanity(const std::string& word) override {
+        reportReadOnly(word);
+    }
+
+    void addProfanity(const std::string& word, BoundaryMode) override {
+        reportReadOnly(word);
+    }
+
+    void addAllowedPhrase(const std::string& phrase) override {
+        reportReadOnly(phrase);
+    }
+
+    void loadFromFile(const std::string& filename) override {
+        reportReadOnly(filename);
+    }
+
+    const std::shared_ptr<const TrieFilter>& baseFilter() const {
+        return base;
+    }
+
+    const std::shared_ptr<const TenantOverlay>& overlayFilter() const {
+        return overlay;
+    }
+
 private:
-    std::vector<std::regex> profanityPatterns;
+    std::shared_ptr<const TrieFilter> base;
+    std::shared_ptr<const TenantOverlay> overlay;
     char replacementChar;
-    
+
+    static void markOverlay(std::vector<Match>& matches, size_t first) {
+        for (size_t i = first; i < matches.size(); ++i) {
+            matches[i].patternId |= kOverlaySource;
+        }
+    }
+
+    static void reportReadOnly(const std::string& what) {
+        std::cerr << "TenantFilter 是只读快照，请通过 TenantFilterRegistry 修改，忽略: " << what << std::endl;
+    }
+};
+
+/**
+ * @brief 多租户过滤器注册表 - 所有租户共享一个编译好的基础词表，每个租户只编译自己的附加词表
+ *
+ * 租户的附加词表在第一次查询时由 loader 填充并编译，缓存的租户数超过容量时淘汰最久未使用的租户，
+ * 之后再访问时重新加载。租户按名称的哈希分到多个分片，每个分片有自己的锁和 LRU 链表，
+ * 不同分片的租户互不阻塞；加载在锁外进行。
+ * filter() 返回只读快照：持有期间该版本不会被销毁，setBase 和 invalidate 只影响之后取得的快照。
+ * 更换基础词表时各租户的附加词表原样保留，只替换共享的基础词表指针（写时复制）。
+ * 内存占用为一份基础词表加上缓存中各租户的附加词表，与租户数和基础词表大小的乘积无关。
+ */
+class TenantFilterRegistry {
 public:
-    explicit RegexFilter(char replacementChar = '*') 
-        : replacementChar(replacementChar) {
-        // 默认正则表达式模式（支持一些变体）
-        addPattern("shit");
-        addPattern("fuck");
-        addPattern("damn");
-        addPattern("ass");
-        addPattern("bitch");
-        addPattern("bastard");
-        // 支持常见变体，如 f*ck, f**k, sh*t 等
-        addPattern("f[aeiou*]+ck");
-        addPattern("sh[aeiou*]+t");
+    /**
+     * @brief 填充租户附加词表的函数，如从数据库读取该租户的自定义词表
+     */
+    using Loader = std::function<void(const std::string& tenant, TenantOverlay& overlay)>;
+
+    /**
+     * @param base 共享的基础词表，发布后不应再修改
+     * @param loader 填充租户附加词表的函数
+     * @param capacity 最多缓存的租户数
+     * @param replacementChar 替换字符
+     */
+    TenantFilterRegistry(std::shared_ptr<const TrieFilter> base, Loader loader, size_t capacity = 4096,
+                         char replacementChar = '*')
+        : base(std::move(base)), loader(std::move(loader)), replacementChar(replacementChar),
+          shardCapacity(std::max<size_t>(1, (capacity + kShardCount - 1) / kShardCount)) {
+        this->base->compiledTrie(); // 提前编译，第一个租户的查询不再等待
     }
-    
-    bool containsProfanity(const std::string& text) const override {
-        std::string lowerText = toLower(text);
-        
-        for (const auto& pattern : profanityPatterns) {
-            if (std::regex_search(lowerText, pattern)) {
-                return true;
+
+    /**
+     * @brief 取得租户的过滤器，不在缓存中时加载并编译它的附加词表
+     */
+    std::shared_ptr<const TenantFilter> filter(const std::string& tenant) {
+        Shard& shard = shardFor(tenant);
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(tenant);
+            if (it != shard.index.end()) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                return it->second->filter;
             }
+            generation = shard.generation;
+        }
+
+        auto overlay = std::make_shared<TenantOverlay>(replacementChar);
+        std::shared_ptr<const TrieFilter> currentBase = baseFilter();
+        overlay->setUtf8Mode(currentBase->isUtf8Mode());
+        overlay->setObfuscationNormalizer(currentBase->obfuscationNormalizer());
+        loader(tenant, *overlay);
+        overlay->compile();
+        auto created = std::make_shared<const TenantFilter>(std::move(currentBase), std::move(overlay), replacementChar);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.generation != generation) {
+            return created; // 加载期间词表已更新，这份结果只交给本次调用
+        }
+        auto it = shard.index.find(tenant);
+        if (it != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            return it->second->filter; // 其他线程已经加载
+        }
+        shard.entries.push_front({tenant, created});
+        shard.index.emplace(tenant, shard.entries.begin());
+        if (shard.entries.size() > shardCapacity) {
+            shard.index.erase(shard.entries.back().tenant);
+            shard.entries.pop_back();
+        }
+        return created;
+    }
+
+    bool containsProfanity(const std::string& tenant, std::string_view text) {
+        return filter(tenant)->containsProfanity(text);
+    }
+
+    std::string censor(const std::string& tenant, std::string_view text) {
+        return filter(tenant)->censor(text);
+    }
+
+    /**
+     * @brief 租户的词表已变化，丢弃缓存，下次访问时重新加载
+     */
+    void invalidate(const std::string& tenant) {
+        Shard& shard = shardFor(tenant);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.generation;
+        auto it = shard.index.find(tenant);
+        if (it != shard.index.end()) {
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
         }
-        return false;
     }
-    
-    std::string censor(const std::string& text) const override {
-        std::string result = text;
-        std::string lowerText = toLower(text);
-        
-        for (const auto& pattern : profanityPatterns) {
-            std::smatch match;
-            std::string::const_iterator searchStart = lowerText.cbegin();
-            
-            while (std::regex_search(searchStart, lowerText.cend(), match, pattern)) {
-                size_t pos = match.position() + (searchStart - lowerText.cbegin());
-                size_t length = match.length();
-                
-                // 替换脏话为指定字符
-                for (size_t i = 0; i < length && pos + i < result.length(); ++i) {
-                    result[pos + i] = replacementChar;
-                }
-                
-                searchStart = match.suffix().first;
+
+    /**
+     * @brief 更换基础词表；已缓存的租户保留附加词表，改为引用新的基础词表
+     */
+    void setBase(std::shared_ptr<const TrieFilter> newBase) {
+        newBase->compiledTrie();
+        std::shared_ptr<const TrieFilter> oldBase = baseFilter();
+        // 附加词表按基础词表的模式编译，模式可能变化时（含任何归一化设置）需要重新加载
+        bool sameMode = newBase->isUtf8Mode() == oldBase->isUtf8Mode() && !newBase->obfuscationNormalizer() &&
+                        !oldBase->obfuscationNormalizer();
+        {
+            std::lock_guard<std::mutex> lock(baseMutex);
+            base = newBase;
+        }
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ++shard.generation;
+            if (!sameMode) {
+                shard.entries.clear();
+                shard.index.clear();
+                continue;
+            }
+            for (Entry& entry : shard.entries) {
+                entry.filter = std::make_shared<const TenantFilter>(newBase, entry.filter->overlayFilter(),
+                                                                    replacementChar);
             }
         }
-        
-        return result;
     }
-    
-    void addProfanity(const std::string& word) override {
-        addPattern(word);
+
+    std::shared_ptr<const TrieFilter> baseFilter() const {
+        std::lock_guard<std::mutex> lock(baseMutex);
+        return base;
     }
-    
-    void loadFromFile(const std::string& filename) override {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "无法打开文件: " << filename << std::endl;
-            return;
+
+    /**
+     * @brief 当前缓存的租户数
+     */
+    size_t size() const {
+        size_t count = 0;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count += shard.entries.size();
         }
-        
-        std::string word;
-        while (std::getline(file, word)) {
-            if (!word.empty()) {
-                addPattern(word);
+        return count;
+    }
+
+    /**
+     * @brief 缓存中各租户附加词表的自动机占用的字节数，不含共享的基础词表
+     */
+    size_t overlayMemoryUsage() const {
+        size_t bytes = 0;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const Entry& entry : shard.entries) {
+                bytes += entry.filter->overlayFilter()->compiledTrie().memoryUsage();
             }
         }
-        file.close();
+        return bytes;
     }
-    
+
 private:
-    void addPattern(const std::string& pattern) {
-        try {
-            profanityPatterns.emplace_back(pattern, std::regex::icase);
-        } catch (const std::regex_error& e) {
-            std::cerr << "正则表达式错误: " << e.what() << " - 模式: " << pattern << std::endl;
-        }
-    }
-    
-    static std::string toLower(const std::string& str) {
-        std::string lower = str;
-        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-        return lower;
+    static constexpr size_t kShardCount = 16;
+
+    struct Entry {
+        std::string tenant;
+        std::shared_ptr<const TenantFilter> filter;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; // 按最近使用排列，最久未使用的在末尾
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        uint64_t generation = 0; // invalidate/setBase 时递增，丢弃之前开始的加载结果
+    };
+
+    mutable std::mutex baseMutex;
+    std::shared_ptr<const TrieFilter> base;
+    Loader loader;
+    char replacementChar;
+    size_t shardCapacity;
+    std::array<Shard, kShardCount> shards;
+
+    Shard& shardFor(const std::string& tenant) {
+        return shards[std::hash<std::string>()(tenant) % kShardCount];
     }
 };
 
 /**
- * @brief 字典树节点，用于高效存储和查找脏话
+ * @brief CachedFilter 的缓存设置
  */
-class TrieNode {
-public:
-    std::unordered_map<char, std::shared_ptr<TrieNode>> children;
-    bool isEndOfWord;
-    
-    TrieNode() : isEndOfWord(false) {}
+struct CacheOptions {
+    size_t capacity = 65536;          // 最多缓存的消息数
+    std::chrono::milliseconds ttl{0}; // 结果的有效期，0 表示不过期
+    size_t maxTextLength = 256;       // 只缓存不超过该长度的消息，长文本很少重复
 };
 
 /**
- * @brief 字典树法 - 使用字典树高效检测脏话
- * 
- * 优点：查找效率高，适合大规模脏话列表
- * 缺点：实现较复杂，内存占用较高
+ * @brief 结果缓存的命中统计
  */
-class TrieFilter : public ProfanityFilter {
-private:
-    std::shared_ptr<TrieNode> root;
-    char replacementChar;
-    
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;   // 因容量淘汰的结果数
+    uint64_t expirations = 0; // 因超过有效期丢弃的结果数
+    size_t size = 0;          // 当前缓存的消息数
+};
+
+/**
+ * @brief 结果缓存装饰器 - 重复的短消息（如 "gg"、表情、复制粘贴的刷屏）直接返回上次的结果
+ *
+ * 包装任意过滤器，缓存 containsProfanity 和 censor / censorInPlace 的结果。消息按 64 位哈希分到多个分片，
+ * 每个分片有自己的锁和 LRU 链表；缓存项同时保存原文，哈希冲突时按未命中处理。
+ * 词表变化时缓存自动失效：包装 FilterHandle 时使用快照的版本号，包装普通过滤器时
+ * 经由本对象调用的修改方法会递增内部版本号。分片在下一次访问时发现版本变化并清空。
+ * findMatches 和 classify 不缓存，直接转发。
+ */
+class CachedFilter final : public ProfanityFilter {
 public:
-    explicit TrieFilter(char replacementChar = '*') 
-        : root(std::make_shared<TrieNode>()), replacementChar(replacementChar) {
-        // 默认脏话列表
-        std::vector<std::string> defaultWords = {
-            "shit", "fuck", "damn", "ass", "bitch", "bastard"
-        };
-        
-        for (const auto& word : defaultWords) {
-            addToTrie(word);
+    /**
+     * @param inner 被包装的过滤器，之后应通过本对象修改词表，否则缓存不会失效
+     */
+    explicit CachedFilter(std::shared_ptr<ProfanityFilter> inner, CacheOptions options = {})
+        : inner(std::move(inner)), options(options),
+          shardCapacity(std::max<size_t>(1, (options.capacity + kShardCount - 1) / kShardCount)) {}
+
+    /**
+     * @brief 包装热更新句柄，每次查询使用句柄的当前快照；handle 的生命周期必须长于本对象
+     */
+    template <typename Filter>
+    explicit CachedFilter(const FilterHandle<Filter>& handle, CacheOptions options = {})
+        : source([&handle] {
+              auto snapshot = handle.snapshot();
+              const ProfanityFilter* filter = snapshot->filter.get();
+              uint64_t version = snapshot->version;
+              return View{std::move(snapshot), filter, version};
+          }),
+          options(options), shardCapacity(std::max<size_t>(1, (options.capacity + kShardCount - 1) / kShardCount)) {}
+
+    using ProfanityFilter::censor;
+    using ProfanityFilter::containsProfanity;
+
+    bool containsProfanity(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Contains, text.size());
+        View view = current();
+        if (text.size() > options.maxTextLength) {
+            return view.filter->containsProfanity(text);
         }
-    }
-    
-    bool containsProfanity(const std::string& text) const override {
-        std::string lowerText = toLower(text);
-        
-        for (size_t i = 0; i < lowerText.length(); ++i) {
-            auto node = root;
-            for (size_t j = i; j < lowerText.length(); ++j) {
-                char c = lowerText[j];
-                if (node->children.find(c) == node->children.end()) {
-                    break;
-                }
-                
-                node = node->children[c];
-                if (node->isEndOfWord) {
-                    return true;
+        uint64_t hash = hashBytes(text.data(), text.size());
+        bool result = false;
+        if (lookup(hash, text, view.version, [&](const Entry& entry) {
+                if (entry.contains < 0) {
+                    return false;
                 }
-            }
+                result = entry.contains != 0;
+                return true;
+            })) {
+            return result;
         }
-        return false;
+        result = view.filter->containsProfanity(text);
+        store(hash, text, view.version, [&](Entry& entry) { entry.contains = result ? 1 : 0; });
+        return result;
     }
-    
-    std::string censor(const std::string& text) const override {
-        std::string result = text;
-        std::string lowerText = toLower(text);
-        
-        for (size_t i = 0; i < lowerText.length(); ++i) {
-            auto node = root;
-            size_t wordEnd = std::string::npos;
-            size_t wordLength = 0;
-            
-            for (size_t j = i; j < lowerText.length(); ++j) {
-                char c = lowerText[j];
-                if (node->children.find(c) == node->children.end()) {
-                    break;
-                }
-                
-                node = node->children[c];
-                if (node->isEndOfWord) {
-                    wordEnd = j;
-                    wordLength = j - i + 1;
-                }
-            }
-            
-            if (wordEnd != std::string::npos) {
-                // 替换脏话为指定字符
-                for (size_t k = 0; k < wordLength; ++k) {
-                    result[i + k] = replacementChar;
+
+    std::string censor(std::string_view text) const override {
+        auto scope = recordCall(MetricsOperation::Censor, text.size());
+        View view = current();
+        if (text.size() > options.maxTextLength) {
+            return view.filter->censor(text);
+        }
+        uint64_t hash = hashBytes(text.data(), text.size());
+        std::string result;
+        if (lookup(hash, text, view.version, [&](const Entry& entry) {
+                if (!entry.hasCensored) {
+                    return false;
                 }
-                i = wordEnd; // 跳过已处理的字符
-            }
+                result = entry.censored;
+                return true;
+            })) {
+            return result;
         }
-        
+        result = view.filter->censor(text);
+        store(hash, text, view.version, [&](Entry& entry) {
+            entry.censored = result;
+            entry.hasCensored = true;
+        });
         return result;
     }
-    
+
+    // 命中时只复制结果，censorInto / censorBatch 不分配内存
+    void censorInPlace(char* buf, size_t len) const override {
+        auto scope = recordCall(MetricsOperation::Censor, len);
+        View view = current();
+        if (len > options.maxTextLength) {
+            view.filter->censorInPlace(buf, len);
+            return;
+        }
+        std::string_view text(buf, len);
+        uint64_t hash = hashBytes(text.data(), text.size());
+        if (lookup(hash, text, view.version, [&](const Entry& entry) {
+                if (!entry.hasCensored || entry.censored.size() != len) {
+                    return false;
+                }
+                std::memcpy(buf, entry.censored.data(), len);
+                return true;
+            })) {
+            return;
+        }
+        std::string original(text);
+        view.filter->censorInPlace(buf, len);
+        store(hash, original, view.version, [&](Entry& entry) {
+            entry.censored.assign(buf, len);
+            entry.hasCensored = true;
+        });
+    }
+
+    void findMatches(std::string_view text, std::vector<Match>& matches) const override {
+        current().filter->findMatches(text, matches);
+    }
+
+    Classification classify(std::string_view text) const override {
+        return current().filter->classify(text);
+    }
+
     void addProfanity(const std::string& word) override {
-        addToTrie(toLower(word));
+        modify(word, [&](ProfanityFilter& filter) { filter.addProfanity(word); });
     }
-    
+
+    void addProfanity(const std::string& word, BoundaryMode boundary) override {
+        modify(word, [&](ProfanityFilter& filter) { filter.addProfanity(word, boundary); });
+    }
+
+    void addAllowedPhrase(const std::string& phrase) override {
+        modify(phrase, [&](ProfanityFilter& filter) { filter.addAllowedPhrase(phrase); });
+    }
+
     void loadFromFile(const std::string& filename) override {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "无法打开文件: " << filename << std::endl;
-            return;
+        modify(filename, [&](ProfanityFilter& filter) { filter.loadFromFile(filename); });
+    }
+
+    void compile() override {
+        if (inner) {
+            inner->compile();
         }
-        
-        std::string word;
-        while (std::getline(file, word)) {
-            if (!word.empty()) {
-                addToTrie(toLower(word));
-            }
+    }
+
+    /**
+     * @brief 丢弃所有缓存的结果，统计数据保留
+     */
+    void clear() {
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
         }
-        file.close();
     }
-    
+
+    CacheStats stats() const {
+        CacheStats total;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total.hits += shard.stats.hits;
+            total.misses += shard.stats.misses;
+            total.evictions += shard.stats.evictions;
+            total.expirations += shard.stats.expirations;
+            total.size += shard.entries.size();
+        }
+        return total;
+    }
+
 private:
-    void addToTrie(const std::string& word) {
-        auto node = root;
-        for (char c : word) {
-            if (node->children.find(c) == node->children.end()) {
-                node->children[c] = std::make_shared<TrieNode>();
-            }
-            node = node->children[c];
+    static constexpr size_t kShardCount = 16;
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 本次查询使用的过滤器及其词表版本；keepAlive 在查询期间持有热更新快照
+     */
+    struct View {
+        std::shared_ptr<const void> keepAlive;
+        const ProfanityFilter* filter;
+        uint64_t version;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        std::string text;
+        std::string censored;
+        Clock::time_point expires;
+        int8_t contains = -1; // -1 表示尚未缓存 containsProfanity 的结果
+        bool hasCensored = false;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; // 按最近使用排列，最久未使用的在末尾
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        uint64_t version = 0; // 缓存项所属的词表版本
+        CacheStats stats;
+    };
+
+    std::function<View()> source;
+    std::shared_ptr<ProfanityFilter> inner;
+    std::atomic<uint64_t> innerVersion{0};
+    CacheOptions options;
+    size_t shardCapacity;
+    mutable std::array<Shard, kShardCount> shards;
+
+    View current() const {
+        if (source) {
+            return source();
         }
-        node->isEndOfWord = true;
+        return View{nullptr, inner.get(), innerVersion.load(std::memory_order_acquire)};
     }
-    
-    static std::string toLower(const std::string& str) {
-        std::string lower = str;
-        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-        return lower;
+
+    template <typename Apply>
+    void modify(const std::string& what, Apply&& apply) {
+        if (!inner) {
+            std::cerr << "CachedFilter 包装的是 FilterHandle 的快照，请通过 FilterHandle 更新词表，忽略: " << what
+                      << std::endl;
+            return;
+        }
+        apply(*inner);
+        innerVersion.fetch_add(1, std::memory_order_release);
     }
-};
 
-/**
- * @brief 混合过滤器 - 结合多种过滤技术
- * 
- * 优点：结合多种技术的优点，提供更好的过滤效果
- * 缺点：实现复杂，资源消耗较大
- */
-class HybridFilter : public ProfanityFilter {
-private:
-    std::unique_ptr<SimpleReplacementFilter> simpleFilter;
-    std::unique_ptr<RegexFilter> regexFilter;
-    std::unique_ptr<TrieFilter> trieFilter;
-    
-    // 使用哪种过滤器（可配置）
-    bool useSimpleFilter = true;
-    bool useRegexFilter = true;
-    bool useTrieFilter = true;
-    
-public:
-    explicit HybridFilter(char replacementChar = '*') {
-        simpleFilter = std::make_unique<SimpleReplacementFilter>(replacementChar);
-        regexFilter = std::make_unique<RegexFilter>(replacementChar);
-        trieFilter = std::make_unique<TrieFilter>(replacementChar);
+    Shard& shardFor(uint64_t hash) const {
+        return shards[(hash >> 60) % kShardCount];
     }
-    
-    bool containsProfanity(const std::string& text) const override {
-        if (useSimpleFilter && simpleFilter->containsProfanity(text)) {
-            return true;
+
+    /**
+     * @brief 分片中的结果属于旧版本的词表时清空分片；version 比分片旧时返回 false
+     */
+    static bool syncVersion(Shard& shard, uint64_t version) {
+        if (version < shard.version) {
+            return false;
         }
-        if (useRegexFilter && regexFilter->containsProfanity(text)) {
-            return true;
+        if (version > shard.version) {
+            shard.entries.clear();
+            shard.index.clear();
+            shard.version = version;
         }
-        if (useTrieFilter && trieFilter->containsProfanity(text)) {
-            return true;
+        return true;
+    }
+
+    /**
+     * @brief 查找 text 的缓存项，read 返回 false 表示该项没有所需的结果
+     */
+    template <typename Read>
+    bool lookup(uint64_t hash, std::string_view text, uint64_t version, Read&& read) const {
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (syncVersion(shard, version)) {
+            auto it = shard.index.find(hash);
+            if (it != shard.index.end() && it->second->text == text) {
+                if (options.ttl.count() > 0 && Clock::now() >= it->second->expires) {
+                    shard.entries.erase(it->second);
+                    shard.index.erase(it);
+                    ++shard.stats.expirations;
+                } else if (read(*it->second)) {
+                    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                    ++shard.stats.hits;
+                    return true;
+                }
+            }
         }
+        ++shard.stats.misses;
         return false;
     }
-    
-    std::string censor(const std::string& text) const override {
-        std::string result = text;
-        
-        if (useSimpleFilter) {
-            result = simpleFilter->censor(result);
+
+    /**
+     * @brief 把 version 版本词表的结果写入 text 的缓存项，必要时新建缓存项并淘汰最久未使用的项
+     */
+    template <typename Write>
+    void store(uint64_t hash, std::string_view text, uint64_t version, Write&& write) const {
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!syncVersion(shard, version)) {
+            return; // 计算期间词表已更新
         }
-        if (useRegexFilter) {
-            result = regexFilter->censor(result);
+        auto it = shard.index.find(hash);
+        if (it != shard.index.end()) {
+            Entry& entry = *it->second;
+            if (entry.text != text) {
+                // 哈希冲突，新消息替换旧消息
+                entry = Entry{hash, std::string(text), {}, expiry(), -1, false};
+            }
+            write(entry);
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            return;
         }
-        if (useTrieFilter) {
-            result = trieFilter->censor(result);
+        shard.entries.push_front(Entry{hash, std::string(text), {}, expiry(), -1, false});
+        write(shard.entries.front());
+        shard.index.emplace(hash, shard.entries.begin());
+        if (shard.entries.size() > shardCapacity) {
+            shard.index.erase(shard.entries.back().hash);
+            shard.entries.pop_back();
+            ++shard.stats.evictions;
         }
-        
-        return result;
-    }
-    
-    void addProfanity(const std::string& word) override {
-        simpleFilter->addProfanity(word);
-        regexFilter->addProfanity(word);
-        trieFilter->addProfanity(word);
     }
-    
-    void loadFromFile(const std::string& filename) override {
-        simpleFilter->loadFromFile(filename);
-        regexFilter->loadFromFile(filename);
-        trieFilter->loadFromFile(filename);
-    }
-    
-    // 配置使用哪些过滤器
-    void configureFilters(bool useSimple, bool useRegex, bool useTrie) {
-        useSimpleFilter = useSimple;
-        useRegexFilter = useRegex;
-        useTrieFilter = useTrie;
+
+    Clock::time_point expiry() const {
+        return options.ttl.count() > 0 ? Clock::now() + options.ttl : Clock::time_point::max();
     }
 };
 
+#ifndef PROFANITY_FILTER_NO_MAIN
 /**
  * @brief 示例使用和测试
+ *
+ * 其他程序（如 profanity_filter_benchmark.cpp）包含本文件时定义 PROFANITY_FILTER_NO_MAIN 去掉示例。
  */
 int main() {
     std::cout << "=== C++ 脏话屏蔽模板示例 ===\n\n";
@@ -448,6 +7796,15 @@ int main() {
     std::cout << "4. 混合过滤器:\n";
     HybridFilter hybridFilter('*');
     
+    std::cout << "5. Aho-Corasick 过滤器:\n";
+    AhoCorasickFilter ahoCorasickFilter('*');
+    
+    std::cout << "6. 编译期字典树过滤器:\n";
+    StaticTrieFilter<DefaultProfanityWords> staticTrieFilter('*');
+    
+    std::cout << "7. 静态组合流水线:\n";
+    FilterPipeline<StaticTrieFilter<DefaultProfanityWords>, RegexFilter> pipelineFilter('*');
+    
     // 从文件加载额外脏话列表（如果存在）
     // simpleFilter.loadFromFile("profanity_list.txt");
     
@@ -456,7 +7813,10 @@ int main() {
         {"简单替换", &simpleFilter},
         {"正则表达式", &regexFilter},
         {"字典树", &trieFilter},
-        {"混合", &hybridFilter}
+        {"混合", &hybridFilter},
+        {"Aho-Corasick ", &ahoCorasickFilter},
+        {"编译期字典树", &staticTrieFilter},
+        {"静态流水线", &pipelineFilter}
     };
     
     for (const auto& [name, filter] : filters) {
@@ -470,6 +7830,132 @@ int main() {
         }
     }
     
+    // 增量扫描：脏话被拆在两个片段中
+    std::cout << "\n=== 增量扫描测试 ===\n";
+    ScanSession session = ahoCorasickFilter.startSession();
+    std::string streamed;
+    for (const char* fragment : {"What the fu", "ck are you ", "doing?"}) {
+        std::string ready = session.feed(fragment);
+        std::cout << "输入: \"" << fragment << "\" 输出: \"" << ready << "\"\n";
+        streamed += ready;
+    }
+    streamed += session.finish();
+    std::cout << "处理后: " << streamed << "\n";
+
+    // 混淆归一化：变体写法与原词匹配，屏蔽原文中对应的全部字节
+    std::cout << "\n=== 混淆归一化测试 ===\n";
+    AhoCorasickFilter obfuscationFilter;
+    obfuscationFilter.setObfuscationNormalizer(ObfuscationNormalizer());
+    for (const char* text : {"What the f@ck!", "Sh1t happens", "fuuuuck this", "You b.i.t.c.h", "He was, she has"}) {
+        std::cout << "原文: " << text << "\n处理后: " << obfuscationFilter.censor(text) << "\n";
+    }
+    // 脏话中的重复字母不折叠："ass" 仍然需要两个 s，多出来的重复字母才被跳过
+    AhoCorasickFilter wholeWordObfuscation('*', std::pmr::get_default_resource(), false);
+    wholeWordObfuscation.setObfuscationNormalizer(ObfuscationNormalizer());
+    wholeWordObfuscation.addProfanity("ass", BoundaryMode::WholeWord);
+    for (const char* text : {"It was a class act, pass", "Kiss my aaasss now"}) {
+        std::cout << "原文: " << text << "\n处理后: " << wholeWordObfuscation.censor(text) << "\n";
+    }
+
+    // 单词边界："ass" 只作为完整单词屏蔽
+    std::cout << "\n=== 单词边界测试 ===\n";
+    AhoCorasickFilter boundaryFilter;
+    boundaryFilter.addProfanity("ass", BoundaryMode::WholeWord);
+    for (const char* text : {"First class passenger", "Kiss my ass!"}) {
+        std::cout << "原文: " << text << "\n处理后: " << boundaryFilter.censor(text) << "\n";
+    }
+
+    std::cout << "\n=== 白名单测试 ===\n";
+    AhoCorasickFilter allowFilter;
+    allowFilter.addAllowedPhrase("assassin");
+    allowFilter.addAllowedPhrase("Scunthorpe");
+    allowFilter.addProfanity("cunt");
+    for (const char* text : {"The assassin left Scunthorpe", "You ass, you cunt"}) {
+        std::cout << "原文: " << text << "\n处理后: " << allowFilter.censor(text) << "\n";
+    }
+
+    // 多租户：共享基础词表，每个租户只编译自己的附加词
+    std::cout << "\n=== 多租户测试 ===\n";
+    TenantFilterRegistry tenants(std::make_shared<AhoCorasickFilter>(), [](const std::string& tenant, TenantOverlay& overlay) {
+        if (tenant == "gaming") {
+            overlay.addProfanity("noob");
+        } else if (tenant == "history") {
+            overlay.addAllowedPhrase("assassin");
+        }
+    });
+    for (const char* tenant : {"gaming", "history"}) {
+        std::cout << tenant << ": " << tenants.censor(tenant, "You noob, the assassin is here") << "\n";
+    }
+
+    // 分级测试：Block 级词条命中后立即停止扫描
+    std::cout << "\n=== 分级测试 ===\n";
+    AhoCorasickFilter tieredFilter('*', std::pmr::get_default_resource(), false);
+    tieredFilter.addProfanity("kill", WordTag{Severity::Block, 1});
+    tieredFilter.addProfanity("damn", WordTag{Severity::Low, 0});
+    for (const char* text : {"damn it", "damn, I will kill you", "hello"}) {
+        Classification result = tieredFilter.classify(text);
+        std::cout << text << " -> 等级 " << static_cast<int>(result.severity)
+                  << " 类别 " << static_cast<int>(result.category) << "\n";
+    }
+
+    // 结果缓存测试：重复的消息直接返回上次的结果
+    std::cout << "\n=== 结果缓存测试 ===\n";
+    CachedFilter cachedFilter(std::make_shared<AhoCorasickFilter>());
+    for (const char* text : {"gg", "shit happens", "gg", "shit happens", "gg"}) {
+        std::cout << text << " -> " << cachedFilter.censor(text) << "\n";
+    }
+    CacheStats cacheStats = cachedFilter.stats();
+    std::cout << "命中 " << cacheStats.hits << " 次，未命中 " << cacheStats.misses << " 次\n";
+
+    // 异步屏蔽测试：长文本交给线程池，取消后不再处理
+    std::cout << "\n=== 异步屏蔽测试 ===\n";
+    std::promise<std::optional<std::string>> asyncResult;
+    std::string longMessage(ProfanityFilter::kAsyncInlineBytes, ' ');
+    longMessage += "fuck";
+    ahoCorasickFilter.censorAsync(longMessage, [&](std::optional<std::string> censored) {
+        asyncResult.set_value(std::move(censored));
+    });
+    std::optional<std::string> asyncCensored = asyncResult.get_future().get();
+    std::cout << "长文本结尾: " << asyncCensored->substr(asyncCensored->size() - 4) << "\n";
+    CancellationSource cancellation;
+    cancellation.cancel();
+    ahoCorasickFilter.censorAsync("shit", [](std::optional<std::string> censored) {
+        std::cout << "已取消: " << (censored ? "否" : "是") << "\n";
+    }, cancellation.token());
+
+    // 近似匹配测试：编辑距离阈值内的拼写变体不需要单独的正则表达式
+    std::cout << "\n=== 近似匹配测试 ===\n";
+    HybridFilter fuzzyHybrid;
+    fuzzyHybrid.addFuzzyProfanity("fuck", 1);
+    fuzzyHybrid.addFuzzyProfanity("bastard", 2);
+    for (const char* text : {"fuk off", "what the fucc", "you b4st4rd", "the fox is funny"}) {
+        std::cout << text << " -> " << fuzzyHybrid.censor(text) << "\n";
+    }
+
+    // 分词查表测试：大词表按单词查布隆过滤器，命中后再精确确认
+    std::cout << "\n=== 分词查表测试 ===\n";
+    TokenFilter tokenFilter;
+    for (const char* text : {"Shit happens", "a classic assessment", "you ASS"}) {
+        std::cout << text << " -> " << tokenFilter.censor(text) << "\n";
+    }
+    std::cout << "布隆过滤器: " << tokenFilter.gateMemoryUsage() << " 字节，" << tokenFilter.size() << " 个词\n";
+
+    // 掩码测试：只取得要屏蔽的位置，由调用方在写出时替换，或直接写入固定大小的缓冲区
+    std::cout << "\n=== 掩码输出测试 ===\n";
+    std::string_view maskText = "What the fuck is this shit?";
+    std::vector<uint64_t> mask;
+    ahoCorasickFilter.censorMask(maskText, mask);
+    std::string masked;
+    for (size_t i = 0; i < maskText.size(); ++i) {
+        masked += ProfanityFilter::isMasked(mask, i) ? '^' : maskText[i];
+    }
+    std::cout << "掩码: " << masked << "\n";
+    char fixed[64];
+    if (ahoCorasickFilter.censorTo(maskText, fixed, sizeof(fixed))) {
+        std::cout << "censorTo: " << std::string_view(fixed, maskText.size()) << "\n";
+    }
+    std::cout << "缓冲区不足: " << (ahoCorasickFilter.censorTo(maskText, fixed, 8) ? "写入" : "拒绝") << "\n";
+
     // 性能测试示例
     std::cout << "\n=== 性能测试示例 ===\n";
     
@@ -492,6 +7978,39 @@ int main() {
     std::cout << "简单替换过滤器: " << timeFilter(simpleFilter, testString) << " ms\n";
     std::cout << "正则表达式过滤器: " << timeFilter(regexFilter, testString) << " ms\n";
     std::cout << "字典树过滤器: " << timeFilter(trieFilter, testString) << " ms\n";
+    std::cout << "Aho-Corasick 过滤器: " << timeFilter(ahoCorasickFilter, testString) << " ms\n";
+    
+    // 批量屏蔽：把一批短消息分摊到线程池
+    std::vector<std::string_view> batch;
+    for (int i = 0; i < 50000; ++i) {
+        batch.push_back(testTexts[i % testTexts.size()]);
+    }
+    std::vector<std::string> censoredBatch;
+    auto batchStart = std::chrono::high_resolution_clock::now();
+    ahoCorasickFilter.censorBatch(batch, censoredBatch);
+    auto batchEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "批量屏蔽 " << batch.size() << " 条消息（" << ThreadPool::shared().size() << " 个线程）: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(batchEnd - batchStart).count() << " ms\n";
+
+    // 并行屏蔽：单个长文档切块后分摊到线程池
+    std::string document;
+    while (document.size() < (size_t(16) << 20)) {
+        document += testString;
+    }
+    auto documentStart = std::chrono::high_resolution_clock::now();
+    std::string censoredDocument = ahoCorasickFilter.censorParallel(document);
+    auto documentEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "并行屏蔽 " << (document.size() >> 20) << " MB 文档: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(documentEnd - documentStart).count() << " ms"
+              << (censoredDocument == ahoCorasickFilter.censor(document) ? "（与逐段扫描结果一致）" : "（结果不一致）")
+              << "\n";
+
+#if defined(PROFANITY_FILTER_METRICS)
+    std::cout << "\n=== 运行时统计 ===\n";
+    hybridFilter.censor(testString);
+    MetricsSnapshot::writePrometheus(std::cout, hybridFilter.metricsSnapshots());
+#endif
     
     return 0;
-}
\ No newline at end of file
+}
+#endif // PROFANITY_FILTER_NO_MAIN
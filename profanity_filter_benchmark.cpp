@@ -0,0 +1,366 @@
+/**
+ * @file profanity_filter_benchmark.cpp
+ * @brief 各过滤器的基准测试，用于跟踪性能回归
+ *
+ * 词表和正文由固定种子的随机数生成，每次运行的输入完全相同。覆盖不同的词表大小、
+ * 消息长度、脏话比例以及 ASCII / UTF-8 两种正文，报告每字节耗时、每秒处理的消息数
+ * 和每次调用的堆分配次数。预热之后各过滤器的每次调用都不应分配内存，出现分配时
+ * 在标准错误输出中报告并以非零状态退出。
+ *
+ * 编译：g++ -std=c++17 -O2 -march=native -pthread profanity_filter_benchmark.cpp -o profanity_filter_benchmark
+ * 运行：./profanity_filter_benchmark [--filter=子串] [--min-time=秒] [--max-words=N]
+ */
+#define PROFANITY_FILTER_NO_MAIN
+#include "profanity_filter.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+// 替换全局 operator new 统计堆分配次数；按对齐分配的版本不经过这里，本项目不使用
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC 把内联后的 std::allocator 与这里的 free 配对时会误报 -Wmismatched-new-delete
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+void operator delete(void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+/**
+ * @brief 可复现的测试输入
+ *
+ * ASCII 词表只用 a-m，填充单词只用 n-z，默认词表中的脏话也都含有 a-m 的字母，
+ * 因此干净的正文中不会出现匹配，脏话比例完全由插入的词决定。
+ * UTF-8 模式下词表为西里尔字母，正文混合中文、希腊字母和 ASCII，插入的脏话一半首字母大写。
+ */
+class BenchmarkCorpus {
+public:
+    /**
+     * @brief 生成 count 个互不相同的词
+     */
+    static std::vector<std::string> makeWords(size_t count, bool utf8, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::set<std::string> unique;
+        std::vector<std::string> words;
+        words.reserve(count);
+        while (words.size() < count) {
+            std::string word;
+            size_t length = utf8 ? 3 + rng() % 5 : 4 + rng() % 7;
+            for (size_t i = 0; i < length; ++i) {
+                if (utf8) {
+                    appendUtf8(word, 0x0430 + rng() % 16); // а-п
+                } else {
+                    word.push_back(static_cast<char>('a' + rng() % 13));
+                }
+            }
+            if (unique.insert(word).second) {
+                words.push_back(std::move(word));
+            }
+        }
+        return words;
+    }
+
+    /**
+     * @brief 生成总长度约为 totalBytes 的一组消息，每条长度不超过 messageSize
+     * @param dirtyRatio 每个单词位置被替换为词表中脏话的概率
+     */
+    static std::vector<std::string> makeMessages(const std::vector<std::string>& words, size_t messageSize,
+                                                 double dirtyRatio, bool utf8, size_t totalBytes, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        size_t count = std::max<size_t>(16, totalBytes / messageSize);
+        std::vector<std::string> messages(count);
+        std::string token;
+        for (std::string& message : messages) {
+            message.reserve(messageSize);
+            while (true) {
+                token.clear();
+                if (chance(rng) < dirtyRatio) {
+                    token = words[rng() % words.size()];
+                    if (utf8 && rng() % 2 == 0) {
+                        token[1] = static_cast<char>(token[1] - 0x20); // а-п 的大写 А-П
+                    }
+                } else {
+                    appendFiller(token, utf8, rng);
+                }
+                token.push_back(rng() % 8 == 0 ? ',' : ' ');
+                if (message.size() + token.size() > messageSize) {
+                    break;
+                }
+                message += token;
+            }
+            message.resize(messageSize, ' ');
+        }
+        return messages;
+    }
+
+private:
+    template <typename Rng>
+    static void appendFiller(std::string& token, bool utf8, Rng& rng) {
+        size_t length = 2 + rng() % 7;
+        switch (utf8 ? rng() % 3 : 0) {
+        case 0:
+            for (size_t i = 0; i < length; ++i) {
+                token.push_back(static_cast<char>('n' + rng() % 13));
+            }
+            break;
+        case 1:
+            for (size_t i = 0; i < length / 2 + 1; ++i) {
+                appendUtf8(token, 0x4e00 + rng() % 2000); // 常用汉字
+            }
+            break;
+        default:
+            for (size_t i = 0; i < length; ++i) {
+                appendUtf8(token, (rng() % 2 ? 0x03b1 : 0x0391) + rng() % 17); // 希腊字母
+            }
+            break;
+        }
+    }
+
+    static void appendUtf8(std::string& out, uint32_t code) {
+        if (code < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+    }
+};
+
+/**
+ * @brief 基准测试运行器：构建过滤器，逐个组合测量并打印结果
+ */
+class BenchmarkRunner {
+public:
+    struct Options {
+        std::string filter;     // 只运行名称中包含该子串的测试
+        double minTime = 0.05;  // 每个测试至少运行的秒数
+        size_t maxWords = 500000;
+    };
+
+    explicit BenchmarkRunner(Options options) : options(std::move(options)) {}
+
+    /**
+     * @return false 如果某个测试在稳定状态下分配了内存
+     */
+    bool run() {
+        std::printf("%-60s %10s %14s %12s\n", "benchmark", "ns/byte", "msgs/sec", "allocs/call");
+        for (bool utf8 : {false, true}) {
+            for (size_t wordCount : kWordCounts) {
+                if (wordCount > options.maxWords) {
+                    continue;
+                }
+                std::vector<std::string> words = BenchmarkCorpus::makeWords(wordCount, utf8, 17);
+                for (const FilterSpec& spec : filterSpecs()) {
+                    if (wordCount <= spec.maxWords) {
+                        runFilter(spec, words, utf8);
+                    }
+                }
+            }
+        }
+        return allocationFailures == 0;
+    }
+
+private:
+    // 各过滤器支持的最大词表：简单替换法对每个词搜索一遍正文，正则表达式法合并的 DFA 有状态数上限
+    struct FilterSpec {
+        const char* name;
+        size_t maxWords;
+        std::function<std::unique_ptr<ProfanityFilter>(bool utf8)> create;
+    };
+
+    // contains 调用 containsProfanity；censor 用 censorTo 写入预先分配的缓冲区；
+    // mask 用 censorMask 得到掩码后再用 applyMask 写出，相当于序列化时直接替换
+    enum class Operation { Contains, Censor, Mask };
+
+    static constexpr size_t kWordCounts[] = {100, 10000, 500000};
+    static constexpr size_t kMessageSizes[] = {64, 1024, 16384};
+    static constexpr double kDirtyRatios[] = {0.0, 0.01, 0.1};
+    static constexpr size_t kCorpusBytes = size_t(1) << 18;
+
+    Options options;
+    size_t allocationFailures = 0;
+
+    static std::vector<FilterSpec> filterSpecs() {
+        auto trie = [](bool utf8) {
+            auto filter = std::make_unique<TrieFilter>();
+            filter->setUtf8Mode(utf8);
+            return std::unique_ptr<ProfanityFilter>(std::move(filter));
+        };
+        auto ahoCorasick = [](bool utf8) {
+            auto filter = std::make_unique<AhoCorasickFilter>();
+            filter->setUtf8Mode(utf8);
+            return std::unique_ptr<ProfanityFilter>(std::move(filter));
+        };
+        return {
+            {"Simple", 500000, [](bool) { return std::make_unique<SimpleReplacementFilter>(); }},
+            {"Regex", 100, [](bool) { return std::make_unique<RegexFilter>(); }},
+            {"Trie", 500000, trie},
+            {"AhoCorasick", 500000, ahoCorasick},
+            {"Hybrid", 100, [](bool) { return std::make_unique<HybridFilter>(); }},
+            {"Fuzzy", 10000, [](bool) { return std::make_unique<FuzzyFilter>(); }},
+            {"Token", 500000, [](bool) { return std::make_unique<TokenFilter>(); }},
+            {"Cached", 500000, [ahoCorasick](bool utf8) {
+                 std::shared_ptr<ProfanityFilter> inner = ahoCorasick(utf8);
+                 return std::make_unique<CachedFilter>(std::move(inner));
+             }},
+        };
+    }
+
+    bool selected(const std::string& name) const {
+        return name.find(options.filter) != std::string::npos;
+    }
+
+    void runFilter(const FilterSpec& spec, const std::vector<std::string>& words, bool utf8) {
+        const std::string prefix = std::string(spec.name) + "/words=" + std::to_string(words.size()) +
+                                   (utf8 ? "/utf8" : "/ascii");
+        bool any = false;
+        forEachCase(prefix, [&](const std::string& name, size_t, double, Operation) { any = any || selected(name); });
+        if (!any) {
+            return; // 不需要构建用不到的过滤器
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<ProfanityFilter> filter = spec.create(utf8);
+        for (const std::string& word : words) {
+            filter->addProfanity(word);
+        }
+        filter->compile();
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-60s %10.1f ms\n", (prefix + "/build").c_str(), buildMs);
+
+        forEachCase(prefix, [&](const std::string& name, size_t messageSize, double dirtyRatio, Operation operation) {
+            if (!selected(name)) {
+                return;
+            }
+            uint32_t seed = static_cast<uint32_t>(messageSize * 131 + dirtyRatio * 1000);
+            std::vector<std::string> messages =
+                BenchmarkCorpus::makeMessages(words, messageSize, dirtyRatio, utf8, kCorpusBytes, seed);
+            Result result = measure(*filter, messages, operation);
+            report(name, result);
+            if (result.allocationsPerCall > 0) {
+                std::cerr << name << ": 稳定状态下每次调用分配了 " << result.allocationsPerCall << " 次内存" << std::endl;
+                ++allocationFailures;
+            }
+        });
+    }
+
+    template <typename Body>
+    static void forEachCase(const std::string& prefix, Body&& body) {
+        for (size_t messageSize : kMessageSizes) {
+            for (double dirtyRatio : kDirtyRatios) {
+                for (Operation operation : {Operation::Contains, Operation::Censor, Operation::Mask}) {
+                    static const char* const suffixes[] = {"/contains", "/censor", "/mask"};
+                    std::string name = prefix + "/msg=" + std::to_string(messageSize) +
+                                       "/dirty=" + std::to_string(static_cast<int>(dirtyRatio * 100)) + "%" +
+                                       suffixes[static_cast<int>(operation)];
+                    body(name, messageSize, dirtyRatio, operation);
+                }
+            }
+        }
+    }
+
+    struct Result {
+        double nsPerByte;
+        double messagesPerSecond;
+        double allocationsPerCall;
+    };
+
+    /**
+     * @brief 循环处理 messages 直到超过 minTime；先预热一轮，输出缓冲区和掩码在各次调用间复用
+     */
+    Result measure(const ProfanityFilter& filter, const std::vector<std::string>& messages,
+                   Operation operation) const {
+        size_t longest = 0;
+        for (const std::string& message : messages) {
+            longest = std::max(longest, message.size());
+        }
+        std::vector<char> out(std::max<size_t>(longest, 1));
+        std::vector<uint64_t> mask;
+        size_t hits = 0;
+        auto once = [&](const std::string& message) {
+            switch (operation) {
+            case Operation::Contains:
+                hits += filter.containsProfanity(std::string_view(message));
+                break;
+            case Operation::Censor:
+                hits += filter.censorTo(message, out.data(), out.size());
+                hits += static_cast<unsigned char>(out[0]);
+                break;
+            case Operation::Mask:
+                filter.censorMask(message, mask);
+                ProfanityFilter::applyMask(message, mask, '*', out.data());
+                hits += static_cast<unsigned char>(out[0]);
+                break;
+            }
+        };
+        for (const std::string& message : messages) {
+            once(message);
+        }
+
+        uint64_t calls = 0;
+        uint64_t bytes = 0;
+        uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do {
+            for (const std::string& message : messages) {
+                once(message);
+                bytes += message.size();
+            }
+            calls += messages.size();
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < options.minTime);
+        uint64_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+        volatile size_t sink = hits; // 防止结果被优化掉
+        (void)sink;
+        return {elapsed * 1e9 / static_cast<double>(bytes), static_cast<double>(calls) / elapsed,
+                static_cast<double>(allocations) / static_cast<double>(calls)};
+    }
+
+    static void report(const std::string& name, const Result& result) {
+        std::printf("%-60s %10.3f %14.0f %12.2f\n", name.c_str(), result.nsPerByte, result.messagesPerSecond,
+                    result.allocationsPerCall);
+        std::fflush(stdout);
+    }
+};
+
+int main(int argc, char** argv) {
+    BenchmarkRunner::Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg.substr(0, 9) == "--filter=") {
+            options.filter = std::string(arg.substr(9));
+        } else if (arg.substr(0, 11) == "--min-time=") {
+            options.minTime = std::atof(argv[i] + 11);
+        } else if (arg.substr(0, 12) == "--max-words=") {
+            options.maxWords = static_cast<size_t>(std::atoll(argv[i] + 12));
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--filter=子串] [--min-time=秒] [--max-words=N]" << std::endl;
+            return 1;
+        }
+    }
+    return BenchmarkRunner(std::move(options)).run() ? 0 : 1;
+}